@@ -0,0 +1,153 @@
+#include "adaptive_policy.h"
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+using namespace std;
+
+const char* GetQueryExecutionName(QueryExecution execution) {
+    switch (execution) {
+        case QueryExecution::TERM_PARALLEL:
+            return "term-parallel";
+        case QueryExecution::DOCUMENT_RANGE_PARALLEL:
+            return "document-range-parallel";
+        default:
+            return "sequential";
+    }
+}
+
+AdaptivePolicySelector::AdaptivePolicySelector()
+        : thread_count_(max(1u, thread::hardware_concurrency())) {
+    PublishThresholds(AdaptivePolicyThresholds());
+}
+
+AdaptivePolicySelector::AdaptivePolicySelector(const AdaptivePolicySelector& other)
+        : thread_count_(other.thread_count_) {
+    PublishThresholds(other.GetThresholds());
+}
+
+AdaptivePolicySelector& AdaptivePolicySelector::operator=(const AdaptivePolicySelector& other) {
+    if (this != &other) {
+        PublishThresholds(other.GetThresholds());
+        ResetStats();
+        thread_count_ = other.thread_count_;
+    }
+    return *this;
+}
+
+void AdaptivePolicySelector::PublishThresholds(const AdaptivePolicyThresholds& thresholds) {
+    lock_guard lock(mutex_);
+    threshold_snapshots_.push_back(make_unique<const AdaptivePolicyThresholds>(thresholds));
+    thresholds_.store(threshold_snapshots_.back().get(), memory_order_release);
+}
+
+void AdaptivePolicySelector::ResetStats() {
+    lock_guard lock(mutex_);
+    decisions_.clear();
+    for (size_t index = 0; index < QUERY_EXECUTION_COUNT; ++index) {
+        query_counts_[index].store(0, memory_order_relaxed);
+        total_latency_ns_[index].store(0, memory_order_relaxed);
+    }
+}
+
+QueryExecution AdaptivePolicySelector::Choose(const QueryCostEstimate& cost) const {
+    return Choose(cost, *thresholds_.load(memory_order_acquire), thread_count_);
+}
+
+QueryExecution AdaptivePolicySelector::Choose(const QueryCostEstimate& cost, const AdaptivePolicyThresholds& thresholds,
+                                              size_t thread_count) {
+    if (thread_count < 2 || cost.GetTotalPostings() < thresholds.min_parallel_postings) {
+        return QueryExecution::SEQUENTIAL;
+    }
+    if (!cost.conjunctive && cost.plus_term_count >= thresholds.min_term_parallel_terms
+        && static_cast<double>(cost.max_term_postings) <= thresholds.max_term_share * static_cast<double>(cost.plus_postings)
+        && static_cast<double>(cost.plus_postings) <= thresholds.max_term_parallel_density * static_cast<double>(cost.document_capacity)) {
+        return QueryExecution::TERM_PARALLEL;
+    }
+    return QueryExecution::DOCUMENT_RANGE_PARALLEL;
+}
+
+void AdaptivePolicySelector::Record(QueryExecution execution, const QueryCostEstimate& cost, chrono::nanoseconds latency) {
+    const size_t index = static_cast<size_t>(execution);
+    const size_t previous_count = query_counts_[index].fetch_add(1, memory_order_relaxed);
+    total_latency_ns_[index].fetch_add(latency.count(), memory_order_relaxed);
+    if (previous_count % DECISION_SAMPLE_PERIOD != 0) {
+        return;
+    }
+    // Журнал - только для диагностики: если он занят, решение не записывается, а запрос не ждёт.
+    unique_lock lock(mutex_, try_to_lock);
+    if (!lock) {
+        return;
+    }
+    if (decisions_.size() == DECISION_LOG_SIZE) {
+        decisions_.pop_front();
+    }
+    decisions_.push_back({execution, cost, latency});
+}
+
+AdaptivePolicyThresholds AdaptivePolicySelector::GetThresholds() const {
+    return *thresholds_.load(memory_order_acquire);
+}
+
+void AdaptivePolicySelector::SetThresholds(const AdaptivePolicyThresholds& thresholds) {
+    PublishThresholds(thresholds);
+}
+
+AdaptivePolicyThresholds AdaptivePolicySelector::FitThresholds(const vector<CalibrationSample>& samples,
+                                                               AdaptivePolicyThresholds thresholds) {
+    constexpr size_t ANY_THREAD_COUNT = numeric_limits<size_t>::max();
+    const auto latency = [](const CalibrationSample& sample, QueryExecution execution) {
+        return sample.latency[static_cast<size_t>(execution)];
+    };
+
+    // Без порога по числу вхождений: выбор между двумя параллельными способами.
+    AdaptivePolicyThresholds always_parallel = thresholds;
+    always_parallel.min_parallel_postings = 0;
+    chrono::nanoseconds term_parallel_total{0};
+    chrono::nanoseconds range_parallel_total{0};
+    for (const CalibrationSample& sample : samples) {
+        if (Choose(sample.cost, always_parallel, ANY_THREAD_COUNT) == QueryExecution::TERM_PARALLEL) {
+            term_parallel_total += latency(sample, QueryExecution::TERM_PARALLEL);
+            range_parallel_total += latency(sample, QueryExecution::DOCUMENT_RANGE_PARALLEL);
+        }
+    }
+    if (term_parallel_total > range_parallel_total) {
+        thresholds.min_term_parallel_terms = numeric_limits<size_t>::max();
+        always_parallel.min_term_parallel_terms = numeric_limits<size_t>::max();
+    }
+
+    // Порог перебирается по стоимостям образцов: запросы дешевле порога идут последовательно.
+    vector<size_t> candidates{numeric_limits<size_t>::max()};
+    for (const CalibrationSample& sample : samples) {
+        candidates.push_back(sample.cost.GetTotalPostings());
+    }
+    sort(candidates.begin(), candidates.end());
+    chrono::nanoseconds best_total = chrono::nanoseconds::max();
+    for (auto It = candidates.rbegin(); It != candidates.rend(); ++It) {
+        chrono::nanoseconds total{0};
+        for (const CalibrationSample& sample : samples) {
+            total += sample.cost.GetTotalPostings() < *It
+                     ? latency(sample, QueryExecution::SEQUENTIAL)
+                     : latency(sample, Choose(sample.cost, always_parallel, ANY_THREAD_COUNT));
+        }
+        if (total < best_total) {
+            best_total = total;
+            thresholds.min_parallel_postings = *It;
+        }
+    }
+    return thresholds;
+}
+
+vector<PolicyDecision> AdaptivePolicySelector::GetDecisions() const {
+    lock_guard lock(mutex_);
+    return {decisions_.begin(), decisions_.end()};
+}
+
+PolicyStats AdaptivePolicySelector::GetStats() const {
+    PolicyStats stats;
+    for (size_t index = 0; index < QUERY_EXECUTION_COUNT; ++index) {
+        stats.query_count[index] = query_counts_[index].load(memory_order_relaxed);
+        stats.total_latency[index] = chrono::nanoseconds(total_latency_ns_[index].load(memory_order_relaxed));
+    }
+    return stats;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Политика для FindTopDocuments: способ выполнения выбирается сервером по оценке стоимости запроса.
+struct AdaptiveExecutionPolicy {};
+inline constexpr AdaptiveExecutionPolicy adaptive_execution{};
+
+// SEQUENTIAL - один поток. TERM_PARALLEL - группы плюс-слов считаются в разных потоках в свои
+// накопители, которые затем складываются. DOCUMENT_RANGE_PARALLEL - потоки делят диапазон id документов.
+enum class QueryExecution {
+    SEQUENTIAL,
+    TERM_PARALLEL,
+    DOCUMENT_RANGE_PARALLEL,
+};
+
+inline constexpr size_t QUERY_EXECUTION_COUNT = 3;
+
+[[nodiscard]] const char* GetQueryExecutionName(QueryExecution execution);
+
+// Оценка стоимости запроса до выполнения. Для режима ALL plus_postings - длина самого редкого
+// списка, умноженная на число плюс-слов: столько шагов пересечения в худшем случае.
+struct QueryCostEstimate {
+    size_t plus_term_count = 0;
+    size_t minus_term_count = 0;
+    size_t plus_postings = 0;
+    size_t minus_postings = 0;
+    size_t max_term_postings = 0;
+    size_t document_capacity = 0;
+    bool conjunctive = false;
+
+    [[nodiscard]] size_t GetTotalPostings() const {
+        return plus_postings + minus_postings;
+    }
+};
+
+struct AdaptivePolicyThresholds {
+    // Запросы, читающие меньше вхождений, выполняются последовательно: запуск задач дороже самой работы.
+    size_t min_parallel_postings = size_t{1} << 15;
+    // Деление по термам выбирается, когда термов хватает на группы, ни один терм не доминирует
+    // и вхождений мало относительно числа документов: тогда потоки при делении по диапазонам id
+    // в основном просматривали бы пустые диапазоны.
+    size_t min_term_parallel_terms = 8;
+    double max_term_share = 0.25;
+    double max_term_parallel_density = 0.05;
+};
+
+struct PolicyDecision {
+    QueryExecution execution = QueryExecution::SEQUENTIAL;
+    QueryCostEstimate cost;
+    std::chrono::nanoseconds latency{0};
+};
+
+struct PolicyStats {
+    std::array<size_t, QUERY_EXECUTION_COUNT> query_count{};
+    std::array<std::chrono::nanoseconds, QUERY_EXECUTION_COUNT> total_latency{};
+};
+
+// Время выполнения одного запроса каждым способом, собранное при калибровке.
+struct CalibrationSample {
+    QueryCostEstimate cost;
+    std::array<std::chrono::nanoseconds, QUERY_EXECUTION_COUNT> latency{};
+};
+
+// Выбирает способ выполнения и ведёт журнал последних решений с измеренной задержкой.
+// Choose и Record можно вызывать из нескольких потоков, на каждом запросе они не берут блокировку:
+// пороги читаются из неизменяемого снимка, счётчики атомарные, а в журнал попадает только каждое
+// DECISION_SAMPLE_PERIOD-е решение каждого способа. Копия получает те же пороги и пустой журнал.
+class AdaptivePolicySelector {
+public:
+    static constexpr size_t DECISION_LOG_SIZE = 1024;
+    static constexpr size_t DECISION_SAMPLE_PERIOD = 16;
+
+    AdaptivePolicySelector();
+    AdaptivePolicySelector(const AdaptivePolicySelector& other);
+    AdaptivePolicySelector& operator=(const AdaptivePolicySelector& other);
+
+    [[nodiscard]] QueryExecution Choose(const QueryCostEstimate& cost) const;
+    void Record(QueryExecution execution, const QueryCostEstimate& cost, std::chrono::nanoseconds latency);
+
+    [[nodiscard]] AdaptivePolicyThresholds GetThresholds() const;
+    void SetThresholds(const AdaptivePolicyThresholds& thresholds);
+
+    // Подбирает порог параллельного выполнения, минимизирующий суммарное время на образцах,
+    // и отключает деление по термам, если на подходящих образцах оно медленнее деления по id.
+    [[nodiscard]] static AdaptivePolicyThresholds FitThresholds(const std::vector<CalibrationSample>& samples,
+                                                                AdaptivePolicyThresholds thresholds);
+
+    [[nodiscard]] std::vector<PolicyDecision> GetDecisions() const;
+    [[nodiscard]] PolicyStats GetStats() const;
+
+private:
+    // Защищает журнал и список снимков порогов.
+    mutable std::mutex mutex_;
+    // Текущий снимок порогов. SetThresholds публикует новый, а старые живут до разрушения селектора,
+    // потому что Choose мог успеть прочитать указатель. Пороги меняются редко: при настройке и калибровке.
+    std::atomic<const AdaptivePolicyThresholds*> thresholds_;
+    std::vector<std::unique_ptr<const AdaptivePolicyThresholds>> threshold_snapshots_;
+    std::deque<PolicyDecision> decisions_;
+    std::array<std::atomic<size_t>, QUERY_EXECUTION_COUNT> query_counts_{};
+    std::array<std::atomic<int64_t>, QUERY_EXECUTION_COUNT> total_latency_ns_{};
+    size_t thread_count_;
+
+    void PublishThresholds(const AdaptivePolicyThresholds& thresholds);
+    void ResetStats();
+
+    [[nodiscard]] static QueryExecution Choose(const QueryCostEstimate& cost, const AdaptivePolicyThresholds& thresholds,
+                                               size_t thread_count);
+};
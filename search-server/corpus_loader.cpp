@@ -0,0 +1,341 @@
+#include "corpus_loader.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+// Очередь между стадиями конвейера. Push ждёт, пока в очереди есть место, Pop - пока есть значение.
+// После Close новые значения не принимаются, а оставшиеся ещё можно забрать.
+template <typename Value>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+            : capacity_(max<size_t>(1, capacity)) {
+    }
+
+    bool Push(Value value) {
+        unique_lock lock(mutex_);
+        not_full_.wait(lock, [this] {
+            return closed_ || values_.size() < capacity_;
+        });
+        if (closed_) {
+            return false;
+        }
+        values_.push_back(move(value));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool Pop(Value& value) {
+        unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this] {
+            return closed_ || !values_.empty();
+        });
+        if (values_.empty()) {
+            return false;
+        }
+        value = move(values_.front());
+        values_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void Close() {
+        lock_guard lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    mutex mutex_;
+    condition_variable not_full_;
+    condition_variable not_empty_;
+    deque<Value> values_;
+    bool closed_ = false;
+};
+
+// Номера кусков, которые разрешено брать в работу: не дальше capacity от первого ещё не проиндексированного.
+// Куски, обогнавшие застрявший, копятся в ожидании своей очереди, и без окна их число ничем не ограничено.
+class SequenceWindow {
+public:
+    explicit SequenceWindow(size_t capacity)
+            : capacity_(max<size_t>(1, capacity)) {
+    }
+
+    // Ждёт, пока кусок sequence войдёт в окно. Возвращает false, если окно закрыто.
+    bool Wait(size_t sequence) {
+        unique_lock lock(mutex_);
+        advanced_.wait(lock, [this, sequence] {
+            return closed_ || sequence < begin_ + capacity_;
+        });
+        return !closed_;
+    }
+
+    void Advance(size_t begin) {
+        lock_guard lock(mutex_);
+        begin_ = begin;
+        advanced_.notify_all();
+    }
+
+    void Close() {
+        lock_guard lock(mutex_);
+        closed_ = true;
+        advanced_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    mutex mutex_;
+    condition_variable advanced_;
+    size_t begin_ = 0;
+    bool closed_ = false;
+};
+
+struct CorpusRecord {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    vector<int> ratings;
+    string_view text;
+};
+
+struct ParsedChunk {
+    size_t sequence = 0;
+    vector<CorpusRecord> records;
+};
+
+struct PreparedChunk {
+    size_t sequence = 0;
+    vector<PreparedDocument> documents;
+};
+
+// Первая ошибка любой стадии: после неё конвейер останавливается, а ошибка пробрасывается вызывающему.
+class PipelineError {
+public:
+    void Set(exception_ptr error) {
+        lock_guard lock(mutex_);
+        if (!error_) {
+            error_ = move(error);
+        }
+        failed_ = true;
+    }
+
+    [[nodiscard]] bool IsSet() const {
+        return failed_;
+    }
+
+    void Rethrow() const {
+        if (error_) {
+            rethrow_exception(error_);
+        }
+    }
+
+private:
+    mutex mutex_;
+    exception_ptr error_;
+    atomic_bool failed_ = false;
+};
+
+// Куски примерно по chunk_size байт, каждый заканчивается концом строки или концом файла.
+vector<string_view> SplitIntoChunks(string_view data, size_t chunk_size) {
+    vector<string_view> chunks;
+    size_t begin = 0;
+    while (begin < data.size()) {
+        size_t end = min(data.size(), begin + chunk_size);
+        if (end < data.size()) {
+            const size_t line_end = data.find('\n', end - 1);
+            end = line_end == string_view::npos ? data.size() : line_end + 1;
+        }
+        chunks.push_back(data.substr(begin, end - begin));
+        begin = end;
+    }
+    return chunks;
+}
+
+string_view NextField(string_view& line, char separator) {
+    const size_t position = line.find(separator);
+    const string_view field = line.substr(0, position);
+    line.remove_prefix(position == string_view::npos ? line.size() : position + 1);
+    return field;
+}
+
+bool ParseInt(string_view text, int& value) {
+    const char* end = text.data() + text.size();
+    const auto [parsed_end, error] = from_chars(text.data(), end, value);
+    return !text.empty() && error == errc() && parsed_end == end;
+}
+
+[[noreturn]] void ThrowMalformedRecord(size_t offset) {
+    throw invalid_argument("Corpus record at byte "s + to_string(offset) + " is malformed."s);
+}
+
+CorpusRecord ParseRecord(string_view line, size_t offset) {
+    CorpusRecord record;
+    int status = 0;
+    const string_view id_field = NextField(line, '\t');
+    const string_view status_field = NextField(line, '\t');
+    string_view ratings_field = NextField(line, '\t');
+    if (!ParseInt(id_field, record.id) || !ParseInt(status_field, status)
+        || status < 0 || status >= static_cast<int>(DocumentAttributes::STATUS_COUNT)) {
+        ThrowMalformedRecord(offset);
+    }
+    record.status = static_cast<DocumentStatus>(status);
+    while (!ratings_field.empty()) {
+        const string_view rating_field = NextField(ratings_field, ' ');
+        int rating = 0;
+        if (rating_field.empty()) {
+            continue;
+        }
+        if (!ParseInt(rating_field, rating)) {
+            ThrowMalformedRecord(offset);
+        }
+        record.ratings.push_back(rating);
+    }
+    record.text = line;
+    return record;
+}
+
+vector<CorpusRecord> ParseChunk(string_view chunk, size_t chunk_offset) {
+    vector<CorpusRecord> records;
+    size_t line_begin = 0;
+    while (line_begin < chunk.size()) {
+        size_t line_end = chunk.find('\n', line_begin);
+        if (line_end == string_view::npos) {
+            line_end = chunk.size();
+        }
+        string_view line = chunk.substr(line_begin, line_end - line_begin);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            records.push_back(ParseRecord(line, chunk_offset + line_begin));
+        }
+        line_begin = line_end + 1;
+    }
+    return records;
+}
+
+PreparedDocument PrepareRecord(const SearchServer& search_server, const CorpusRecord& record) {
+    try {
+        return search_server.PrepareDocument(record.id, record.text, record.status, record.ratings);
+    } catch (const invalid_argument& error) {
+        throw invalid_argument("Corpus document "s + to_string(record.id) + ": "s + error.what());
+    }
+}
+
+}  // namespace
+
+CorpusLoadStats LoadCorpus(SearchServer& search_server, const string& path, const CorpusLoaderOptions& options) {
+    const MappedFile file(path);
+    const string_view data = file.GetData();
+    const vector<string_view> chunks = SplitIntoChunks(data, max<size_t>(1, options.chunk_size));
+
+    const size_t hardware_threads = max(1u, thread::hardware_concurrency());
+    const size_t parse_threads = options.parse_threads > 0 ? options.parse_threads
+                                                           : max<size_t>(1, hardware_threads / 4);
+    const size_t tokenize_threads = options.tokenize_threads > 0 ? options.tokenize_threads
+                                                                 : max<size_t>(1, hardware_threads - min(hardware_threads, parse_threads + 1));
+
+    BoundedQueue<ParsedChunk> parsed_chunks(options.queue_capacity);
+    BoundedQueue<PreparedChunk> prepared_chunks(options.queue_capacity);
+    // По куску в работе у каждого потока и queue_capacity готовых, ждущих следующей стадии или своей очереди.
+    SequenceWindow window(options.queue_capacity + parse_threads + tokenize_threads);
+    PipelineError pipeline_error;
+    atomic_size_t next_chunk = 0;
+    atomic_size_t active_parsers = parse_threads;
+    atomic_size_t active_tokenizers = tokenize_threads;
+
+    const auto fail = [&](exception_ptr error) {
+        pipeline_error.Set(move(error));
+        window.Close();
+        parsed_chunks.Close();
+        prepared_chunks.Close();
+    };
+
+    vector<thread> workers;
+    workers.reserve(parse_threads + tokenize_threads);
+    for (size_t i = 0; i < parse_threads; ++i) {
+        workers.emplace_back([&] {
+            try {
+                for (size_t sequence = next_chunk++; sequence < chunks.size() && !pipeline_error.IsSet(); sequence = next_chunk++) {
+                    if (!window.Wait(sequence)) {
+                        break;
+                    }
+                    const string_view chunk = chunks[sequence];
+                    ParsedChunk parsed{sequence, ParseChunk(chunk, static_cast<size_t>(chunk.data() - data.data()))};
+                    if (!parsed_chunks.Push(move(parsed))) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                fail(current_exception());
+            }
+            if (--active_parsers == 0) {
+                parsed_chunks.Close();
+            }
+        });
+    }
+    for (size_t i = 0; i < tokenize_threads; ++i) {
+        workers.emplace_back([&] {
+            try {
+                ParsedChunk parsed;
+                while (!pipeline_error.IsSet() && parsed_chunks.Pop(parsed)) {
+                    PreparedChunk prepared{parsed.sequence, {}};
+                    prepared.documents.reserve(parsed.records.size());
+                    for (const CorpusRecord& record : parsed.records) {
+                        prepared.documents.push_back(PrepareRecord(search_server, record));
+                    }
+                    if (!prepared_chunks.Push(move(prepared))) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                fail(current_exception());
+            }
+            if (--active_tokenizers == 0) {
+                prepared_chunks.Close();
+            }
+        });
+    }
+
+    CorpusLoadStats stats;
+    stats.byte_count = data.size();
+    stats.chunk_count = chunks.size();
+    try {
+        // Куски приходят не по порядку: ждущие своей очереди лежат здесь, индексируются строго по номеру.
+        map<size_t, vector<PreparedDocument>> waiting_chunks;
+        size_t next_sequence = 0;
+        PreparedChunk prepared;
+        while (!pipeline_error.IsSet() && prepared_chunks.Pop(prepared)) {
+            waiting_chunks.emplace(prepared.sequence, move(prepared.documents));
+            for (auto It = waiting_chunks.begin(); It != waiting_chunks.end() && It->first == next_sequence;
+                 It = waiting_chunks.erase(It), ++next_sequence) {
+                for (PreparedDocument& document : It->second) {
+                    search_server.AddPreparedDocument(move(document));
+                    ++stats.document_count;
+                }
+            }
+            window.Advance(next_sequence);
+        }
+    } catch (...) {
+        fail(current_exception());
+    }
+
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    pipeline_error.Rethrow();
+    return stats;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "search_server.h"
+#include <cstddef>
+#include <string>
+
+// Параметры загрузки. Нулевое число потоков - по числу ядер.
+struct CorpusLoaderOptions {
+    size_t chunk_size = size_t{1} << 20;
+    size_t parse_threads = 0;
+    size_t tokenize_threads = 0;
+    // Сколько готовых кусков может ждать следующую стадию. Ограничивает память, если индексация отстаёт:
+    // в работе одновременно не больше queue_capacity кусков сверх тех, что обрабатывают потоки.
+    size_t queue_capacity = 8;
+};
+
+struct CorpusLoadStats {
+    size_t document_count = 0;
+    size_t byte_count = 0;
+    size_t chunk_count = 0;
+};
+
+// Загружает корпус из файла: по документу на строку, id<TAB>статус<TAB>рейтинги через пробел<TAB>текст.
+// Строки могут заканчиваться и \n, и \r\n, пустые строки пропускаются. Файл отображается в память
+// и режется на куски по границам строк, дальше куски проходят конвейер: разбор полей -> разбиение текста на слова -> добавление в индекс.
+// Первые две стадии многопоточные, индекс строится в вызывающем потоке в порядке кусков в файле,
+// поэтому результат не отличается от последовательного AddDocument. При ошибке бросает исключение,
+// документы до ошибочного к этому моменту уже могут быть в индексе.
+CorpusLoadStats LoadCorpus(SearchServer& search_server, const std::string& path,
+                           const CorpusLoaderOptions& options = {});
@@ -0,0 +1,93 @@
+#include "document_attributes.h"
+
+using namespace std;
+
+DocumentFilter::DocumentFilter(DocumentStatus status)
+        : status_mask(1u << static_cast<unsigned>(status)) {
+}
+
+DocumentFilter::DocumentFilter(initializer_list<DocumentStatus> statuses)
+        : status_mask(0) {
+    for (const DocumentStatus status : statuses) {
+        status_mask |= 1u << static_cast<unsigned>(status);
+    }
+}
+
+DocumentFilter& DocumentFilter::WithRatingRange(int min, int max) {
+    min_rating = min;
+    max_rating = max;
+    return *this;
+}
+
+bool DocumentFilter::AcceptsStatus(DocumentStatus status) const {
+    return (status_mask & (1u << static_cast<unsigned>(status))) != 0;
+}
+
+bool DocumentFilter::AcceptsRating(int rating) const {
+    return rating >= min_rating && rating <= max_rating;
+}
+
+int DocumentAttributes::Add(int document_id, DocumentStatus status, int rating) {
+    int slot = 0;
+    if (free_slots_.empty()) {
+        slot = static_cast<int>(statuses_.size());
+        document_ids_.push_back(document_id);
+        statuses_.push_back(status);
+        ratings_.push_back(rating);
+    } else {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+        document_ids_[slot] = document_id;
+        statuses_[slot] = status;
+        ratings_[slot] = rating;
+    }
+    slots_.emplace(document_id, slot);
+    status_bitmaps_[static_cast<size_t>(status)].Set(slot);
+    return slot;
+}
+
+void DocumentAttributes::Remove(int document_id) {
+    const auto It = slots_.find(document_id);
+    const int slot = It->second;
+    slots_.erase(It);
+    status_bitmaps_[static_cast<size_t>(statuses_[slot])].Reset(slot);
+    statuses_[slot] = DocumentStatus::REMOVED;
+    free_slots_.push_back(slot);
+}
+
+void DocumentAttributes::Update(int document_id, DocumentStatus status, int rating) {
+    const int slot = slots_.at(document_id);
+    status_bitmaps_[static_cast<size_t>(statuses_[slot])].Reset(slot);
+    statuses_[slot] = status;
+    ratings_[slot] = rating;
+    status_bitmaps_[static_cast<size_t>(status)].Set(slot);
+}
+
+int DocumentAttributes::FindSlot(int document_id) const {
+    const auto It = slots_.find(document_id);
+    return It == slots_.end() ? -1 : It->second;
+}
+
+const DocumentBitmap& DocumentAttributes::GetStatusBitmap(DocumentStatus status) const {
+    return status_bitmaps_[static_cast<size_t>(status)];
+}
+
+const DocumentBitmap& DocumentAttributes::BuildStatusMask(const DocumentFilter& filter, DocumentBitmap& buffer) const {
+    size_t accepted_count = 0;
+    size_t last_accepted = 0;
+    for (size_t status = 0; status < STATUS_COUNT; ++status) {
+        if (filter.AcceptsStatus(static_cast<DocumentStatus>(status))) {
+            ++accepted_count;
+            last_accepted = status;
+        }
+    }
+    if (accepted_count == 1) {
+        return status_bitmaps_[last_accepted];
+    }
+    for (size_t status = 0; status < STATUS_COUNT; ++status) {
+        if (filter.AcceptsStatus(static_cast<DocumentStatus>(status))) {
+            buffer |= status_bitmaps_[status];
+        }
+    }
+    return buffer;
+}
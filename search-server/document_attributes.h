@@ -0,0 +1,74 @@
+#pragma once
+#include "document.h"
+#include "document_bitmap.h"
+#include <array>
+#include <climits>
+#include <initializer_list>
+#include <unordered_map>
+#include <vector>
+
+// Структурированный фильтр документов: допустимые статусы и диапазон рейтинга [min_rating, max_rating].
+// В отличие от произвольного предиката его можно применить к колонкам атрибутов до подсчёта релевантности.
+struct DocumentFilter {
+    DocumentFilter() = default;
+    explicit DocumentFilter(DocumentStatus status);
+    DocumentFilter(std::initializer_list<DocumentStatus> statuses);
+
+    DocumentFilter& WithRatingRange(int min, int max);
+
+    [[nodiscard]] bool AcceptsStatus(DocumentStatus status) const;
+    [[nodiscard]] bool AcceptsRating(int rating) const;
+
+    unsigned status_mask = ~0u;
+    int min_rating = INT_MIN;
+    int max_rating = INT_MAX;
+};
+
+// Колоночное хранилище атрибутов. При добавлении документ получает слот - плотный номер, по которому
+// его статус и рейтинг лежат в массивах, а сам он - в битовых масках статусов. Слоты удалённых документов
+// переиспользуются, поэтому колонки растут с числом документов, а не с величиной их id.
+class DocumentAttributes {
+public:
+    static constexpr size_t STATUS_COUNT = 4;
+
+    // Выдаёт документу слот и возвращает его.
+    int Add(int document_id, DocumentStatus status, int rating);
+    // Освобождает слот документа.
+    void Remove(int document_id);
+    // Меняет статус и рейтинг уже добавленного документа.
+    void Update(int document_id, DocumentStatus status, int rating);
+
+    // Слот документа или -1, если документа нет.
+    [[nodiscard]] int FindSlot(int document_id) const;
+
+    [[nodiscard]] int GetDocumentId(int slot) const {
+        return document_ids_[slot];
+    }
+
+    [[nodiscard]] DocumentStatus GetStatus(int slot) const {
+        return statuses_[slot];
+    }
+
+    [[nodiscard]] int GetRating(int slot) const {
+        return ratings_[slot];
+    }
+
+    // Размер колонок: наибольшее число документов, одновременно лежавших в хранилище.
+    [[nodiscard]] size_t GetCapacity() const {
+        return statuses_.size();
+    }
+
+    [[nodiscard]] const DocumentBitmap& GetStatusBitmap(DocumentStatus status) const;
+
+    // Маска слотов документов, статус которых допускает фильтр. Для одного статуса возвращается
+    // готовая маска хранилища, иначе маски объединяются в buffer.
+    [[nodiscard]] const DocumentBitmap& BuildStatusMask(const DocumentFilter& filter, DocumentBitmap& buffer) const;
+
+private:
+    std::unordered_map<int, int> slots_;
+    std::vector<int> free_slots_;
+    std::vector<int> document_ids_;
+    std::vector<DocumentStatus> statuses_;
+    std::vector<int> ratings_;
+    std::array<DocumentBitmap, STATUS_COUNT> status_bitmaps_;
+};
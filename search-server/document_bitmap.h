@@ -0,0 +1,109 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Плотное битовое множество id документов.
+class DocumentBitmap {
+public:
+    void Set(int document_id) {
+        const size_t word_index = static_cast<size_t>(document_id) / BITS_PER_WORD;
+        if (word_index >= words_.size()) {
+            words_.resize(word_index + 1, 0);
+        }
+        words_[word_index] |= Mask(document_id);
+    }
+
+    void Reset(int document_id) {
+        const size_t word_index = static_cast<size_t>(document_id) / BITS_PER_WORD;
+        if (word_index < words_.size()) {
+            words_[word_index] &= ~Mask(document_id);
+        }
+    }
+
+    [[nodiscard]] bool Test(int document_id) const {
+        const size_t word_index = static_cast<size_t>(document_id) / BITS_PER_WORD;
+        return word_index < words_.size() && (words_[word_index] & Mask(document_id)) != 0;
+    }
+
+    // Выделяет место под id меньше bit_count, после этого Set для них не перераспределяет память
+    // и разные потоки могут менять непересекающиеся диапазоны, выровненные по 64 id.
+    void Reserve(size_t bit_count) {
+        const size_t word_count = (bit_count + BITS_PER_WORD - 1) / BITS_PER_WORD;
+        if (word_count > words_.size()) {
+            words_.resize(word_count, 0);
+        }
+    }
+
+    // Вызывает action для установленных битов из [begin_id, end_id) по возрастанию id и сбрасывает их.
+    template <typename Action>
+    void ExtractEach(int begin_id, int end_id, Action action) {
+        const size_t begin = static_cast<size_t>(begin_id);
+        const size_t end = std::min(static_cast<size_t>(end_id), words_.size() * BITS_PER_WORD);
+        for (size_t word_index = begin / BITS_PER_WORD; word_index * BITS_PER_WORD < end; ++word_index) {
+            uint64_t word = words_[word_index];
+            const size_t word_begin = word_index * BITS_PER_WORD;
+            if (word_begin < begin) {
+                word &= ~uint64_t{0} << (begin - word_begin);
+            }
+            if (end - word_begin < BITS_PER_WORD) {
+                word &= (uint64_t{1} << (end - word_begin)) - 1;
+            }
+            words_[word_index] &= ~word;
+            while (word != 0) {
+                const int bit = __builtin_ctzll(word);
+                action(static_cast<int>(word_begin + bit));
+                word &= word - 1;
+            }
+        }
+    }
+
+    // Число установленных битов в [begin_id, end_id).
+    [[nodiscard]] size_t Count(int begin_id, int end_id) const {
+        const size_t begin = static_cast<size_t>(begin_id);
+        const size_t end = std::min(static_cast<size_t>(end_id), words_.size() * BITS_PER_WORD);
+        size_t count = 0;
+        for (size_t word_index = begin / BITS_PER_WORD; word_index * BITS_PER_WORD < end; ++word_index) {
+            uint64_t word = words_[word_index];
+            const size_t word_begin = word_index * BITS_PER_WORD;
+            if (word_begin < begin) {
+                word &= ~uint64_t{0} << (begin - word_begin);
+            }
+            if (end - word_begin < BITS_PER_WORD) {
+                word &= (uint64_t{1} << (end - word_begin)) - 1;
+            }
+            count += static_cast<size_t>(__builtin_popcountll(word));
+        }
+        return count;
+    }
+
+    // Сбрасывает биты mask в слове word_index, то есть id [64 * word_index, 64 * word_index + 64),
+    // и возвращает те из них, что были установлены.
+    uint64_t ExtractWord(size_t word_index, uint64_t mask) {
+        if (word_index >= words_.size()) {
+            return 0;
+        }
+        const uint64_t extracted = words_[word_index] & mask;
+        words_[word_index] &= ~extracted;
+        return extracted;
+    }
+
+    DocumentBitmap& operator|=(const DocumentBitmap& other) {
+        if (other.words_.size() > words_.size()) {
+            words_.resize(other.words_.size(), 0);
+        }
+        for (size_t i = 0; i < other.words_.size(); ++i) {
+            words_[i] |= other.words_[i];
+        }
+        return *this;
+    }
+
+private:
+    static constexpr size_t BITS_PER_WORD = 64;
+    std::vector<uint64_t> words_;
+
+    static uint64_t Mask(int document_id) {
+        return uint64_t{1} << (static_cast<size_t>(document_id) % BITS_PER_WORD);
+    }
+};
@@ -1,5 +1,11 @@
 #include "search_server.h"
+#include "process_queries.h"
+#include "query_generator.h"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
 #include <execution>
 #include <iostream>
 #include <random>
@@ -7,53 +13,10 @@
 #include <vector>
 
 #include "log_duration.h"
+#include "perf_counters.h"
 
 using namespace std;
 
-string GenerateWord(mt19937& generator, int max_length) {
-    const int length = uniform_int_distribution(1, max_length)(generator);
-    string word;
-    word.reserve(length);
-    for (int i = 0; i < length; ++i) {
-        word.push_back(uniform_int_distribution('a', 'z')(generator));
-    }
-    return word;
-}
-
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-    vector<string> words;
-    words.reserve(word_count);
-    for (int i = 0; i < word_count; ++i) {
-        words.push_back(GenerateWord(generator, max_length));
-    }
-    sort(words.begin(), words.end());
-    words.erase(unique(words.begin(), words.end()), words.end());
-    return words;
-}
-
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
-        }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-            query.push_back('-');
-        }
-        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
-    }
-    return query;
-}
-
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
-    vector<string> queries;
-    queries.reserve(query_count);
-    for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
-    }
-    return queries;
-}
-
 template <typename ExecutionPolicy>
 void Test(string_view mark, SearchServer search_server, const string& query, ExecutionPolicy&& policy) {
     LOG_DURATION(mark);
@@ -66,9 +29,83 @@ void Test(string_view mark, SearchServer search_server, const string& query, Exe
     cout << word_count << endl;
 }
 
+// Пакет запросов по отдельности и с общим сканированием списков вхождений: сколько вхождений прочитано
+// и сколько времени заняло. Запросы, которым не с кем делить списки, пакет выполняет по отдельности.
+void TestBatch(const SearchServer& search_server, const vector<string>& queries) {
+    using Clock = chrono::steady_clock;
+    const auto to_ms = [](Clock::duration duration) {
+        return chrono::duration_cast<chrono::milliseconds>(duration).count();
+    };
+
+    size_t independent_count = 0;
+    const auto independent_start = Clock::now();
+    for (const auto& documents : ProcessQueries(search_server, queries)) {
+        independent_count += documents.size();
+    }
+    const auto independent_time = Clock::now() - independent_start;
+
+    size_t batched_count = 0;
+    BatchScanStats stats;
+    const auto batched_start = Clock::now();
+    for (const auto& documents : ProcessQueriesBatched(search_server, queries, &stats)) {
+        batched_count += documents.size();
+    }
+    const auto batched_time = Clock::now() - batched_start;
+
+    cout << independent_count << ' ' << batched_count << endl;
+    cout << "postings read: "s << stats.postings_read_independent << " independent, "s << stats.postings_read
+         << " batched in "s << stats.group_count << " groups ("s << stats.independent_count << " alone)"s << endl;
+    cout << "wall time: "s << to_ms(independent_time) << " ms independent, "s << to_ms(batched_time) << " ms batched"s << endl;
+}
+
+// Те же запросы к индексу с частотами в FLOAT32. Релевантность общих документов выдачи должна отличаться
+// от посчитанной в DOUBLE не больше чем на 6e-8 от своей величины (см. TermWeightPrecision), а документ,
+// которого нет в выдаче DOUBLE, - быть неотличим по IsMoreRelevant от последнего документа этой выдачи.
+void TestTermWeightPrecision(const SearchServer& search_server, const vector<string>& queries) {
+    constexpr double RELATIVE_ERROR_BOUND = 6e-8;
+    SearchServer float_server = search_server;
+    float_server.SetTermWeightPrecision(TermWeightPrecision::FLOAT32);
+
+    double max_relative_error = 0.0;
+    size_t violation_count = 0;
+    for (const string& query : queries) {
+        const vector<Document> expected = search_server.FindTopDocuments(query);
+        const vector<Document> actual = float_server.FindTopDocuments(query);
+        if (actual.size() != expected.size()) {
+            ++violation_count;
+            continue;
+        }
+        for (const Document& document : actual) {
+            const auto It = find_if(expected.begin(), expected.end(), [&document](const Document& other) {
+                return other.id == document.id;
+            });
+            if (It == expected.end()) {
+                if (SearchServer::IsMoreRelevant(document, expected.back()) || SearchServer::IsMoreRelevant(expected.back(), document)) {
+                    ++violation_count;
+                }
+                continue;
+            }
+            if (It->relevance > 0.0) {
+                const double relative_error = abs(document.relevance - It->relevance) / It->relevance;
+                max_relative_error = max(max_relative_error, relative_error);
+                violation_count += relative_error > RELATIVE_ERROR_BOUND;
+            }
+        }
+    }
+    cout << "float32 term weights: max relative error "s << max_relative_error << ", bound "s << RELATIVE_ERROR_BOUND
+         << ", violations "s << violation_count << endl;
+    assert(violation_count == 0);
+}
+
 #define TEST(policy) Test(#policy, search_server, query, execution::policy)
 
-int main() {
+// С --perf-counters после замеров времени печатает в cerr аппаратные счётчики горячих функций.
+int main(int argc, char* argv[]) {
+    const bool perf_counters = argc > 1 && argv[1] == "--perf-counters"s;
+    if (perf_counters) {
+        PerfProfiler::Enable();
+    }
+
     mt19937 generator;
 
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
@@ -83,4 +120,11 @@ int main() {
 
     TEST(seq);
     TEST(par);
+
+    TestBatch(search_server, GenerateQueries(generator, dictionary, 2'000, 7));
+    TestTermWeightPrecision(search_server, GenerateQueries(generator, dictionary, 2'000, 7));
+
+    if (perf_counters) {
+        cerr << PerfProfiler::GetReport();
+    }
 }
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "mapped_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+#include <vector>
+
+using namespace std;
+
+MappedFile::MappedFile(const string& path, MappedFileAccess access) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw system_error(errno, generic_category(), "open "s + path);
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) < 0) {
+        const int error = errno;
+        close(fd);
+        throw system_error(error, generic_category(), "fstat "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            const int error = errno;
+            close(fd);
+            throw system_error(error, generic_category(), "mmap "s + path);
+        }
+        madvise(data, size_, access == MappedFileAccess::SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+        data_ = static_cast<const char*>(data);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+size_t MappedFile::GetResidentBytes() const {
+    if (data_ == nullptr) {
+        return 0;
+    }
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t page_count = (size_ + page_size - 1) / page_size;
+    vector<unsigned char> residency(page_count);
+    if (mincore(const_cast<char*>(data_), size_, residency.data()) < 0) {
+        return 0;
+    }
+    size_t resident_bytes = 0;
+    for (size_t page = 0; page < page_count; ++page) {
+        if (residency[page] & 1) {
+            resident_bytes += min(page_size, size_ - page * page_size);
+        }
+    }
+    return resident_bytes;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Как файл будет читаться: подсказка ядру для упреждающего чтения.
+enum class MappedFileAccess {
+    SEQUENTIAL,
+    RANDOM,
+};
+
+// Файл, отображённый в память только для чтения.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path, MappedFileAccess access = MappedFileAccess::SEQUENTIAL);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    [[nodiscard]] std::string_view GetData() const {
+        return {data_, size_};
+    }
+
+    // Сколько байт отображения сейчас в памяти, по данным mincore.
+    [[nodiscard]] size_t GetResidentBytes() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
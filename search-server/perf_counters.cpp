@@ -0,0 +1,331 @@
+#include "perf_counters.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+using namespace std;
+
+namespace {
+
+struct PerfEventConfig {
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr PerfEventConfig PERF_EVENT_CONFIGS[PERF_EVENT_COUNT] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+// Счётчик событий текущего потока в user space. group_fd = -1 открывает лидера новой группы.
+int OpenPerfEvent(size_t event, int group_fd) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_EVENT_CONFIGS[event].type;
+    attr.config = PERF_EVENT_CONFIGS[event].config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+// Группа счётчиков одного потока: все читаются одним read с лидера.
+class PerfCounterGroup {
+public:
+    explicit PerfCounterGroup(const array<bool, PERF_EVENT_COUNT>& events) {
+        for (size_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+            if (!events[event]) {
+                continue;
+            }
+            const int fd = OpenPerfEvent(event, fds_.empty() ? -1 : fds_.front());
+            if (fd < 0) {
+                // Поток без полного набора счётчиков меряет только время, а не часть событий.
+                Close();
+                return;
+            }
+            fds_.push_back(fd);
+            events_.push_back(event);
+        }
+    }
+
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    ~PerfCounterGroup() {
+        Close();
+    }
+
+    // Накопленные с открытия значения. Если группу вытесняли другие счётчики, значения
+    // домножаются на отношение времени включения ко времени счёта.
+    bool Read(array<uint64_t, PERF_EVENT_COUNT>& values) const {
+        if (fds_.empty()) {
+            return false;
+        }
+        uint64_t buffer[3 + PERF_EVENT_COUNT];
+        const ssize_t expected = static_cast<ssize_t>((3 + fds_.size()) * sizeof(uint64_t));
+        if (read(fds_.front(), buffer, sizeof(buffer)) != expected || buffer[0] != fds_.size()) {
+            return false;
+        }
+        const uint64_t time_enabled = buffer[1];
+        const uint64_t time_running = buffer[2];
+        for (size_t i = 0; i < events_.size(); ++i) {
+            uint64_t value = buffer[3 + i];
+            if (time_running > 0 && time_running < time_enabled) {
+                value = static_cast<uint64_t>(static_cast<double>(value) * time_enabled / time_running);
+            }
+            values[events_[i]] = value;
+        }
+        return true;
+    }
+
+private:
+    vector<int> fds_;
+    vector<size_t> events_;
+
+    void Close() {
+        for (const int fd : fds_) {
+            close(fd);
+        }
+        fds_.clear();
+        events_.clear();
+    }
+};
+
+// Статистика одного потока. Пишет её только сам поток, мьютекс нужен для чтения отчёта.
+struct ThreadPerfState {
+    size_t thread_index = 0;
+    mutex scopes_mutex;
+    map<string_view, PerfScopeStats> scopes;
+};
+
+struct PerfRegistry {
+    mutex registry_mutex;
+    array<bool, PERF_EVENT_COUNT> event_available{};
+    string unavailable_reason;
+    // Состояния живут здесь и после завершения своих потоков.
+    vector<shared_ptr<ThreadPerfState>> threads;
+};
+
+PerfRegistry& GetRegistry() {
+    static PerfRegistry registry;
+    return registry;
+}
+
+// Регистрирует поток при первом замере и открывает его счётчики из найденных Enable.
+struct ThreadPerfContext {
+    shared_ptr<ThreadPerfState> state = make_shared<ThreadPerfState>();
+    optional<PerfCounterGroup> counters;
+
+    ThreadPerfContext() {
+        PerfRegistry& registry = GetRegistry();
+        lock_guard lock(registry.registry_mutex);
+        state->thread_index = registry.threads.size();
+        registry.threads.push_back(state);
+        counters.emplace(registry.event_available);
+    }
+};
+
+ThreadPerfContext& GetThreadContext() {
+    thread_local ThreadPerfContext context;
+    return context;
+}
+
+}  // namespace
+
+atomic<bool> PerfProfiler::enabled_ = false;
+
+const char* GetPerfEventName(PerfEvent event) {
+    switch (event) {
+        case PerfEvent::CYCLES:
+            return "cycles";
+        case PerfEvent::INSTRUCTIONS:
+            return "instructions";
+        case PerfEvent::LLC_MISSES:
+            return "LLC-misses";
+        default:
+            return "branch-misses";
+    }
+}
+
+PerfScopeStats& PerfScopeStats::operator+=(const PerfScopeStats& other) {
+    calls += other.calls;
+    wall += other.wall;
+    counted_calls += other.counted_calls;
+    for (size_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+        counters[event] += other.counters[event];
+    }
+    return *this;
+}
+
+bool PerfReport::HasCounters() const {
+    return find(event_available.begin(), event_available.end(), true) != event_available.end();
+}
+
+map<string, PerfScopeStats> PerfReport::GetTotals() const {
+    map<string, PerfScopeStats> totals;
+    for (const PerfThreadReport& thread : threads) {
+        for (const auto& [label, stats] : thread.scopes) {
+            totals[label] += stats;
+        }
+    }
+    return totals;
+}
+
+bool PerfProfiler::Enable() {
+    PerfRegistry& registry = GetRegistry();
+    bool any_available = false;
+    {
+        lock_guard lock(registry.registry_mutex);
+        registry.unavailable_reason.clear();
+        for (size_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+            const int fd = OpenPerfEvent(event, -1);
+            registry.event_available[event] = fd >= 0;
+            any_available = any_available || fd >= 0;
+            if (fd >= 0) {
+                close(fd);
+            } else if (registry.unavailable_reason.empty()) {
+                registry.unavailable_reason = GetPerfEventName(static_cast<PerfEvent>(event)) + ": "s + strerror(errno);
+            }
+        }
+    }
+    enabled_.store(true, memory_order_relaxed);
+    return any_available;
+}
+
+void PerfProfiler::Disable() {
+    enabled_.store(false, memory_order_relaxed);
+}
+
+void PerfProfiler::Reset() {
+    PerfRegistry& registry = GetRegistry();
+    lock_guard lock(registry.registry_mutex);
+    for (const auto& thread : registry.threads) {
+        lock_guard thread_lock(thread->scopes_mutex);
+        thread->scopes.clear();
+    }
+}
+
+PerfReport PerfProfiler::GetReport() {
+    PerfRegistry& registry = GetRegistry();
+    lock_guard lock(registry.registry_mutex);
+    PerfReport report;
+    report.event_available = registry.event_available;
+    report.unavailable_reason = registry.unavailable_reason;
+    for (const auto& thread : registry.threads) {
+        lock_guard thread_lock(thread->scopes_mutex);
+        if (thread->scopes.empty()) {
+            continue;
+        }
+        PerfThreadReport& thread_report = report.threads.emplace_back();
+        thread_report.thread_index = thread->thread_index;
+        for (const auto& [label, stats] : thread->scopes) {
+            thread_report.scopes.emplace(string(label), stats);
+        }
+    }
+    return report;
+}
+
+void PerfScope::Start(const char* label) {
+    label_ = label;
+    ThreadPerfContext& context = GetThreadContext();
+    start_time_ = Clock::now();
+    counted_ = context.counters->Read(start_counters_);
+}
+
+void PerfScope::Stop() {
+    ThreadPerfContext& context = GetThreadContext();
+    array<uint64_t, PERF_EVENT_COUNT> end_counters{};
+    const bool counted = counted_ && context.counters->Read(end_counters);
+    const auto end_time = Clock::now();
+
+    lock_guard lock(context.state->scopes_mutex);
+    PerfScopeStats& stats = context.state->scopes[label_];
+    ++stats.calls;
+    stats.wall += end_time - start_time_;
+    if (counted) {
+        ++stats.counted_calls;
+        for (size_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+            stats.counters[event] += end_counters[event] - start_counters_[event];
+        }
+    }
+}
+
+namespace {
+
+void PrintScopeRow(ostream& output, const PerfReport& report, const string& label, const string& thread,
+                   const PerfScopeStats& stats) {
+    output << left << setw(32) << label << right << setw(8) << thread << setw(10) << stats.calls
+           << setw(12) << fixed << setprecision(3) << chrono::duration<double, milli>(stats.wall).count()
+           << setw(12) << stats.wall.count() / static_cast<int64_t>(max<uint64_t>(1, stats.calls));
+    if (report.HasCounters()) {
+        const double calls = static_cast<double>(max<uint64_t>(1, stats.counted_calls));
+        const auto counter = [&stats](PerfEvent event) {
+            return static_cast<double>(stats.counters[static_cast<size_t>(event)]);
+        };
+        const auto available = [&report](PerfEvent event) {
+            return report.event_available[static_cast<size_t>(event)];
+        };
+        output << setprecision(0);
+        for (size_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+            if (report.event_available[event]) {
+                output << setw(14) << counter(static_cast<PerfEvent>(event)) / calls;
+            } else {
+                output << setw(14) << "-"s;
+            }
+        }
+        output << setprecision(2);
+        if (available(PerfEvent::CYCLES) && available(PerfEvent::INSTRUCTIONS) && counter(PerfEvent::CYCLES) > 0) {
+            output << setw(7) << counter(PerfEvent::INSTRUCTIONS) / counter(PerfEvent::CYCLES);
+        } else {
+            output << setw(7) << "-"s;
+        }
+        for (const PerfEvent event : {PerfEvent::LLC_MISSES, PerfEvent::BRANCH_MISSES}) {
+            if (available(event) && available(PerfEvent::INSTRUCTIONS) && counter(PerfEvent::INSTRUCTIONS) > 0) {
+                output << setw(10) << 1000.0 * counter(event) / counter(PerfEvent::INSTRUCTIONS);
+            } else {
+                output << setw(10) << "-"s;
+            }
+        }
+    }
+    output << defaultfloat << setprecision(6) << '\n';
+}
+
+}  // namespace
+
+ostream& operator<<(ostream& output, const PerfReport& report) {
+    if (!report.HasCounters()) {
+        output << "perf counters unavailable ("s << report.unavailable_reason << "), wall time only\n"s;
+    }
+    output << left << setw(32) << "scope"s << right << setw(8) << "thread"s << setw(10) << "calls"s
+           << setw(12) << "wall ms"s << setw(12) << "ns/call"s;
+    if (report.HasCounters()) {
+        for (size_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+            output << setw(14) << GetPerfEventName(static_cast<PerfEvent>(event));
+        }
+        output << setw(7) << "IPC"s << setw(10) << "LLC MPKI"s << setw(10) << "br MPKI"s;
+    }
+    output << '\n';
+
+    for (const auto& [label, total] : report.GetTotals()) {
+        PrintScopeRow(output, report, label, "all"s, total);
+        if (report.threads.size() < 2) {
+            continue;
+        }
+        for (const PerfThreadReport& thread : report.threads) {
+            const auto It = thread.scopes.find(label);
+            if (It != thread.scopes.end()) {
+                PrintScopeRow(output, report, ""s, "#"s + to_string(thread.thread_index), It->second);
+            }
+        }
+    }
+    return output;
+}
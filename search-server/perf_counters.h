@@ -0,0 +1,119 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define PERF_CONCAT_INTERNAL(X, Y) X##Y
+#define PERF_CONCAT(X, Y) PERF_CONCAT_INTERNAL(X, Y)
+
+/**
+ * Макрос, как LOG_DURATION, замеряет блок до его конца, но вместо печати прибавляет время
+ * и показания аппаратных счётчиков к статистике блока label в текущем потоке.
+ * label должен быть строковым литералом. Пока профилирование не включено PerfProfiler::Enable,
+ * макрос стоит одну проверку флага.
+ *
+ *  void Task() {
+ *      PERF_SCOPE("Task");
+ *      ...
+ *  }
+ */
+#define PERF_SCOPE(label) PerfScope PERF_CONCAT(perfScopeGuard, __LINE__)(label)
+
+enum class PerfEvent {
+    CYCLES,
+    INSTRUCTIONS,
+    LLC_MISSES,
+    BRANCH_MISSES,
+};
+
+constexpr size_t PERF_EVENT_COUNT = 4;
+
+[[nodiscard]] const char* GetPerfEventName(PerfEvent event);
+
+struct PerfScopeStats {
+    uint64_t calls = 0;
+    std::chrono::nanoseconds wall{0};
+    // Вызовы, для которых удалось прочитать счётчики. Остальные учтены только во wall.
+    uint64_t counted_calls = 0;
+    std::array<uint64_t, PERF_EVENT_COUNT> counters{};
+
+    PerfScopeStats& operator+=(const PerfScopeStats& other);
+};
+
+struct PerfThreadReport {
+    // Номер потока в порядке первого замера.
+    size_t thread_index = 0;
+    std::map<std::string, PerfScopeStats> scopes;
+};
+
+struct PerfReport {
+    // Какие счётчики удалось открыть. Если ни одного, в отчёте только число вызовов и время.
+    std::array<bool, PERF_EVENT_COUNT> event_available{};
+    std::string unavailable_reason;
+    std::vector<PerfThreadReport> threads;
+
+    [[nodiscard]] bool HasCounters() const;
+    // Статистика блоков, сложенная по всем потокам.
+    [[nodiscard]] std::map<std::string, PerfScopeStats> GetTotals() const;
+};
+
+// Таблица по блокам: сначала суммы по потокам, затем строки каждого потока. Для счётчиков печатаются
+// среднее на вызов, IPC и промахи на тысячу инструкций.
+std::ostream& operator<<(std::ostream& output, const PerfReport& report);
+
+// Профилировщик на perf_event_open. Каждый поток при первом замере открывает свою группу счётчиков
+// (только user space, поэтому хватает perf_event_paranoid <= 2). Если ядро или виртуальная машина
+// счётчиков не дают, блоки всё равно считают вызовы и время.
+class PerfProfiler {
+public:
+    // Проверяет, какие счётчики доступны, и включает замеры. Возвращает true, если доступен хотя бы один.
+    static bool Enable();
+    static void Disable();
+    [[nodiscard]] static bool IsEnabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Обнуляет накопленную статистику всех потоков.
+    static void Reset();
+    [[nodiscard]] static PerfReport GetReport();
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+// Замер одного блока. Используется через PERF_SCOPE.
+class PerfScope {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit PerfScope(const char* label) {
+        if (PerfProfiler::IsEnabled()) {
+            Start(label);
+        }
+    }
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+    ~PerfScope() {
+        if (label_ != nullptr) {
+            Stop();
+        }
+    }
+
+private:
+    const char* label_ = nullptr;
+    Clock::time_point start_time_;
+    bool counted_ = false;
+    std::array<uint64_t, PERF_EVENT_COUNT> start_counters_{};
+
+    void Start(const char* label);
+    void Stop();
+};
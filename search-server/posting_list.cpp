@@ -0,0 +1,242 @@
+#include "posting_list.h"
+#include "scoring_kernel.h"
+#include <algorithm>
+
+using namespace std;
+
+PostingList::PostingList(const PostingList& other) {
+    *this = other;
+}
+
+PostingList& PostingList::operator=(const PostingList& other) {
+    if (this == &other) {
+        return *this;
+    }
+    document_ids_ = other.document_ids_;
+    term_freqs_ = other.term_freqs_;
+    term_freqs_f32_ = other.term_freqs_f32_;
+    precision_ = other.precision_;
+    cold_ = other.cold_;
+    bitmap_ = other.bitmap_ ? make_unique<RoaringBitmap>(*other.bitmap_) : nullptr;
+    if (cold_) {
+        document_id_data_ = other.document_id_data_;
+        term_freq_data_ = other.term_freq_data_;
+        term_freq_f32_data_ = other.term_freq_f32_data_;
+        size_ = other.size_;
+    } else {
+        BindVectors();
+    }
+    return *this;
+}
+
+PostingList::PostingList(PostingList&& other) noexcept {
+    *this = move(other);
+}
+
+PostingList& PostingList::operator=(PostingList&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    document_ids_ = move(other.document_ids_);
+    term_freqs_ = move(other.term_freqs_);
+    term_freqs_f32_ = move(other.term_freqs_f32_);
+    precision_ = other.precision_;
+    cold_ = other.cold_;
+    document_id_data_ = other.document_id_data_;
+    term_freq_data_ = other.term_freq_data_;
+    term_freq_f32_data_ = other.term_freq_f32_data_;
+    size_ = other.size_;
+    bitmap_ = move(other.bitmap_);
+    if (!cold_) {
+        BindVectors();
+    }
+    other.cold_ = false;
+    other.document_ids_.clear();
+    other.term_freqs_.clear();
+    other.term_freqs_f32_.clear();
+    other.BindVectors();
+    return *this;
+}
+
+void PostingList::Set(int document_id, double term_freq) {
+    MakeHot();
+    const size_t position = document_ids_.empty() || document_ids_.back() < document_id ? document_ids_.size()
+                                                                                        : LowerBound(document_id);
+    if (position < document_ids_.size() && document_ids_[position] == document_id) {
+        if (precision_ == TermWeightPrecision::DOUBLE) {
+            term_freqs_[position] = term_freq;
+        } else {
+            term_freqs_f32_[position] = static_cast<float>(term_freq);
+        }
+        return;
+    }
+    document_ids_.insert(document_ids_.begin() + position, document_id);
+    if (precision_ == TermWeightPrecision::DOUBLE) {
+        term_freqs_.insert(term_freqs_.begin() + position, term_freq);
+    } else {
+        term_freqs_f32_.insert(term_freqs_f32_.begin() + position, static_cast<float>(term_freq));
+    }
+    BindVectors();
+    if (bitmap_) {
+        bitmap_->Add(document_id);
+    }
+    UpdateBitmap();
+}
+
+bool PostingList::Erase(int document_id) {
+    if (!Contains(document_id)) {
+        return false;
+    }
+    MakeHot();
+    const size_t position = LowerBound(document_id);
+    document_ids_.erase(document_ids_.begin() + position);
+    if (precision_ == TermWeightPrecision::DOUBLE) {
+        term_freqs_.erase(term_freqs_.begin() + position);
+    } else {
+        term_freqs_f32_.erase(term_freqs_f32_.begin() + position);
+    }
+    BindVectors();
+    if (bitmap_) {
+        bitmap_->Remove(document_id);
+    }
+    UpdateBitmap();
+    return true;
+}
+
+bool PostingList::Contains(int document_id) const {
+    if (bitmap_) {
+        return bitmap_->Contains(document_id);
+    }
+    const size_t position = LowerBound(document_id);
+    return position < size_ && document_id_data_[position] == document_id;
+}
+
+size_t PostingList::size() const {
+    return size_;
+}
+
+bool PostingList::empty() const {
+    return size_ == 0;
+}
+
+size_t PostingList::Gallop(size_t from, int document_id) const {
+    size_t low = from;
+    size_t high = from;
+    size_t step = 1;
+    while (high < size_ && document_id_data_[high] < document_id) {
+        low = high + 1;
+        high += step;
+        step *= 2;
+    }
+    high = min(high, size_);
+    return lower_bound(document_id_data_ + low, document_id_data_ + high, document_id) - document_id_data_;
+}
+
+TermWeightPrecision PostingList::GetPrecision() const {
+    return precision_;
+}
+
+void PostingList::SetPrecision(TermWeightPrecision precision) {
+    if (precision == precision_) {
+        return;
+    }
+    MakeHot();
+    if (precision == TermWeightPrecision::FLOAT32) {
+        term_freqs_f32_.assign(term_freqs_.begin(), term_freqs_.end());
+        term_freqs_ = vector<double>();
+    } else {
+        term_freqs_.assign(term_freqs_f32_.begin(), term_freqs_f32_.end());
+        term_freqs_f32_ = vector<float>();
+    }
+    precision_ = precision;
+    BindVectors();
+}
+
+void PostingList::AccumulateImpacts(size_t begin, size_t end, double inverse_document_freq, double* accumulator) const {
+    if (precision_ == TermWeightPrecision::DOUBLE) {
+        ::AccumulateImpacts(document_id_data_ + begin, term_freq_data_ + begin, end - begin, inverse_document_freq, accumulator);
+    } else {
+        ::AccumulateImpacts(document_id_data_ + begin, term_freq_f32_data_ + begin, end - begin, inverse_document_freq, accumulator);
+    }
+}
+
+PostingList::Iterator PostingList::begin() const {
+    return {this, 0};
+}
+
+PostingList::Iterator PostingList::end() const {
+    return {this, size_};
+}
+
+bool PostingList::IsCold() const {
+    return cold_;
+}
+
+size_t PostingList::GetDataBytes() const {
+    return size_ * (sizeof(int) + (precision_ == TermWeightPrecision::DOUBLE ? sizeof(double) : sizeof(float)));
+}
+
+size_t PostingList::GetHotBytes() const {
+    if (bitmap_) {
+        return GetDataBytes() + bitmap_->GetMemoryBytes();
+    }
+    if (size_ >= BITMAP_MIN_SIZE) {
+        return GetDataBytes() + RoaringBitmap::EstimateMemoryBytes(document_id_data_, size_);
+    }
+    return GetDataBytes();
+}
+
+const int* PostingList::GetDocumentIdData() const {
+    return document_id_data_;
+}
+
+const void* PostingList::GetTermFreqData() const {
+    return precision_ == TermWeightPrecision::DOUBLE ? static_cast<const void*>(term_freq_data_) : term_freq_f32_data_;
+}
+
+void PostingList::MakeCold(const int* document_ids, const void* term_freqs) {
+    const size_t size = size_;
+    document_ids_ = vector<int>();
+    term_freqs_ = vector<double>();
+    term_freqs_f32_ = vector<float>();
+    cold_ = true;
+    document_id_data_ = document_ids;
+    term_freq_data_ = precision_ == TermWeightPrecision::DOUBLE ? static_cast<const double*>(term_freqs) : nullptr;
+    term_freq_f32_data_ = precision_ == TermWeightPrecision::FLOAT32 ? static_cast<const float*>(term_freqs) : nullptr;
+    size_ = size;
+    bitmap_.reset();
+}
+
+void PostingList::MakeHot() {
+    if (!cold_) {
+        return;
+    }
+    document_ids_.assign(document_id_data_, document_id_data_ + size_);
+    if (precision_ == TermWeightPrecision::DOUBLE) {
+        term_freqs_.assign(term_freq_data_, term_freq_data_ + size_);
+    } else {
+        term_freqs_f32_.assign(term_freq_f32_data_, term_freq_f32_data_ + size_);
+    }
+    cold_ = false;
+    BindVectors();
+    UpdateBitmap();
+}
+
+void PostingList::BindVectors() {
+    document_id_data_ = document_ids_.data();
+    term_freq_data_ = term_freqs_.data();
+    term_freq_f32_data_ = term_freqs_f32_.data();
+    size_ = document_ids_.size();
+}
+
+void PostingList::UpdateBitmap() {
+    if (!bitmap_ && size_ >= BITMAP_MIN_SIZE) {
+        bitmap_ = make_unique<RoaringBitmap>(document_id_data_, size_);
+    } else if (bitmap_ && size_ < BITMAP_MIN_SIZE / 2) {
+        bitmap_.reset();
+    }
+}
+
+size_t PostingList::LowerBound(int document_id) const {
+    return lower_bound(document_id_data_, document_id_data_ + size_, document_id) - document_id_data_;
+}
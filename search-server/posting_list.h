@@ -0,0 +1,131 @@
+#pragma once
+#include "roaring_bitmap.h"
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Точность хранения частот термов. FLOAT32 вдвое уменьшает объём частот, который читается при подсчёте
+// релевантности. Относительная ошибка частоты после округления до float не больше 2^-24 (около 6e-8),
+// все вклады в релевантность неотрицательны и складываются в double, поэтому релевантность отличается
+// от посчитанной в double не больше чем на 6e-8 от своей величины. Это меньше DOUBLE_COMPARISON_ERROR
+// сервера при релевантности до 16, и порядок выдачи может измениться только для документов, релевантности
+// которых и так различаются меньше этой величины.
+enum class TermWeightPrecision {
+    DOUBLE,
+    FLOAT32,
+};
+
+// Список вхождений терма: id документов по возрастанию и частота терма в каждом из них.
+// Горячий список хранит данные в своих векторах. Холодный только ссылается на них в отображённом
+// файле: читается так же, а при первом изменении копирует данные в память и снова становится горячим.
+// У длинного списка вдобавок ведётся множество его id в виде RoaringBitmap: по нему минус-слова
+// снимаются с кандидатов пословно, а Contains не ищет по массиву.
+class PostingList {
+public:
+    // Множество id строится, когда список дорастает до BITMAP_MIN_SIZE, и удаляется, когда он
+    // сокращается вдвое ниже порога.
+    static constexpr size_t BITMAP_MIN_SIZE = 4096;
+
+    class Iterator {
+    public:
+        Iterator(const PostingList* postings, size_t position)
+                : postings_(postings), position_(position) {
+        }
+
+        std::pair<int, double> operator*() const {
+            return {postings_->DocumentIdAt(position_), postings_->TermFreqAt(position_)};
+        }
+
+        Iterator& operator++() {
+            ++position_;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return position_ == other.position_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return position_ != other.position_;
+        }
+
+    private:
+        const PostingList* postings_;
+        size_t position_;
+    };
+
+    PostingList() = default;
+    PostingList(const PostingList& other);
+    PostingList(PostingList&& other) noexcept;
+    PostingList& operator=(const PostingList& other);
+    PostingList& operator=(PostingList&& other) noexcept;
+
+    void Set(int document_id, double term_freq);
+    bool Erase(int document_id);
+
+    [[nodiscard]] bool Contains(int document_id) const;
+    // nullptr, если список короче BITMAP_MIN_SIZE.
+    [[nodiscard]] const RoaringBitmap* GetBitmap() const {
+        return bitmap_.get();
+    }
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] bool empty() const;
+
+    [[nodiscard]] int DocumentIdAt(size_t position) const {
+        return document_id_data_[position];
+    }
+
+    [[nodiscard]] double TermFreqAt(size_t position) const {
+        return precision_ == TermWeightPrecision::DOUBLE ? term_freq_data_[position] : static_cast<double>(term_freq_f32_data_[position]);
+    }
+
+    [[nodiscard]] TermWeightPrecision GetPrecision() const;
+    // Переводит частоты в заданную точность.
+    void SetPrecision(TermWeightPrecision precision);
+
+    // Прибавляет term_freq * inverse_document_freq к accumulator[document_id] для позиций [begin, end).
+    void AccumulateImpacts(size_t begin, size_t end, double inverse_document_freq, double* accumulator) const;
+
+    // Позиция первого документа с id >= document_id, не левее from.
+    // Экспоненциальный поиск: шаги удваиваются, затем бинарный поиск в найденном окне.
+    [[nodiscard]] size_t Gallop(size_t from, int document_id) const;
+
+    [[nodiscard]] Iterator begin() const;
+    [[nodiscard]] Iterator end() const;
+
+    [[nodiscard]] bool IsCold() const;
+    // Объём id и частот: сколько список занимает в памяти, будучи горячим, или в файле, будучи холодным.
+    [[nodiscard]] size_t GetDataBytes() const;
+    // Сколько список занимает в памяти горячим: данные и множество id длинного списка.
+    [[nodiscard]] size_t GetHotBytes() const;
+    // Массивы size() id и size() частот в текущей точности, для записи списка в файл.
+    [[nodiscard]] const int* GetDocumentIdData() const;
+    [[nodiscard]] const void* GetTermFreqData() const;
+
+    // Делает список холодным: данные в той же точности уже лежат по этим адресам и живут дольше списка.
+    // Множество id тоже освобождается, холодный список не держит в памяти ничего своего.
+    void MakeCold(const int* document_ids, const void* term_freqs);
+    // Копирует данные холодного списка в память и заново строит множество id.
+    void MakeHot();
+
+private:
+    std::vector<int> document_ids_;
+    std::vector<double> term_freqs_;
+    std::vector<float> term_freqs_f32_;
+    TermWeightPrecision precision_ = TermWeightPrecision::DOUBLE;
+    bool cold_ = false;
+    // Через эти указатели идёт всё чтение: они смотрят в векторы выше или, у холодного списка, в файл.
+    const int* document_id_data_ = nullptr;
+    const double* term_freq_data_ = nullptr;
+    const float* term_freq_f32_data_ = nullptr;
+    size_t size_ = 0;
+    std::unique_ptr<RoaringBitmap> bitmap_;
+
+    // Направляет указатели на векторы после их изменения.
+    void BindVectors();
+    // Строит или удаляет множество id после изменения размера.
+    void UpdateBitmap();
+
+    [[nodiscard]] size_t LowerBound(int document_id) const;
+};
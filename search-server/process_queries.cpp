@@ -33,4 +33,11 @@ std::vector<Document> ProcessQueriesJoined(
 
         }
         return result;
+}
+
+std::vector<std::vector<Document>> ProcessQueriesBatched(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries,
+        BatchScanStats* stats){
+    return search_server.FindTopDocumentsBatch(queries, DocumentStatus::ACTUAL, stats);
 }
\ No newline at end of file
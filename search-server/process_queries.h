@@ -7,4 +7,11 @@ std::vector<std::vector<Document>> ProcessQueries(
 
 std::vector<Document> ProcessQueriesJoined(
         const SearchServer& search_server,
-        const std::vector<std::string>& queries);
\ No newline at end of file
+        const std::vector<std::string>& queries);
+
+// То же, что ProcessQueries, но через FindTopDocumentsBatch: списки вхождений общих слов
+// читаются один раз на группу запросов, а не для каждого запроса.
+std::vector<std::vector<Document>> ProcessQueriesBatched(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries,
+        BatchScanStats* stats = nullptr);
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "query_generator.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+template <typename WordPicker>
+string GenerateQueryWith(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob,
+                         WordPicker pick_word) {
+    string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (!query.empty()) {
+            query.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            query.push_back('-');
+        }
+        query += dictionary[pick_word()];
+    }
+    return query;
+}
+
+}  // namespace
+
+ZipfDistribution::ZipfDistribution(size_t size, double exponent) {
+    cumulative_.reserve(size);
+    double sum = 0.0;
+    for (size_t rank = 0; rank < size; ++rank) {
+        sum += 1.0 / pow(static_cast<double>(rank + 1), exponent);
+        cumulative_.push_back(sum);
+    }
+}
+
+size_t ZipfDistribution::operator()(mt19937& generator) const {
+    const double point = uniform_real_distribution<>(0, cumulative_.back())(generator);
+    const auto It = upper_bound(cumulative_.begin(), cumulative_.end(), point);
+    return min(static_cast<size_t>(It - cumulative_.begin()), cumulative_.size() - 1);
+}
+
+string GenerateWord(mt19937& generator, int max_length) {
+    const int length = uniform_int_distribution(1, max_length)(generator);
+    string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(uniform_int_distribution('a', 'z')(generator));
+    }
+    return word;
+}
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back(GenerateWord(generator, max_length));
+    }
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob) {
+    return GenerateQueryWith(generator, dictionary, word_count, minus_prob, [&] {
+        return uniform_int_distribution<int>(0, dictionary.size() - 1)(generator);
+    });
+}
+
+string GenerateQuery(mt19937& generator, const vector<string>& dictionary, const ZipfDistribution& word_distribution,
+                     int word_count, double minus_prob) {
+    return GenerateQueryWith(generator, dictionary, word_count, minus_prob, [&] {
+        return word_distribution(generator);
+    });
+}
+
+vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+    }
+    return queries;
+}
+
+vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary,
+                               const ZipfDistribution& word_distribution, int query_count, int max_word_count,
+                               double minus_prob) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, word_distribution, max_word_count, minus_prob));
+    }
+    return queries;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+// Генераторы случайных слов, документов и запросов для замеров производительности.
+
+// Номер слова в словаре по закону Ципфа: номер k выпадает с вероятностью, пропорциональной 1 / (k + 1)^exponent.
+// При exponent = 0 распределение равномерное.
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t size, double exponent);
+
+    [[nodiscard]] size_t operator()(std::mt19937& generator) const;
+
+private:
+    std::vector<double> cumulative_;
+};
+
+std::string GenerateWord(std::mt19937& generator, int max_length);
+
+// Отсортированный словарь без повторов, поэтому слов может оказаться меньше word_count.
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length);
+
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count,
+                          double minus_prob = 0);
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary,
+                          const ZipfDistribution& word_distribution, int word_count, double minus_prob = 0);
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary,
+                                         int query_count, int max_word_count);
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary,
+                                         const ZipfDistribution& word_distribution, int query_count,
+                                         int max_word_count, double minus_prob = 0);
@@ -0,0 +1,58 @@
+#include "query_profile.h"
+#include <algorithm>
+
+using namespace std;
+
+ostream& operator<<(ostream& output, const QueryProfile& profile) {
+    output << "query \""s << profile.raw_query << "\" mode="s << (profile.cost.conjunctive ? "all"s : "any"s)
+           << " suggested="s << GetQueryExecutionName(profile.suggested_execution) << '\n';
+    for (const TermProfile& term : profile.terms) {
+        output << "  term "s << (term.is_minus ? "-"s : ""s) << term.word << " df="s << term.document_frequency;
+        if (!term.is_minus) {
+            output << " idf="s << term.inverse_document_freq;
+        }
+        output << " visited="s << term.postings_visited << '\n';
+    }
+    output << "  candidates="s << profile.candidate_count << " excluded_by_minus="s << profile.excluded_by_minus
+           << " rejected_by_filter="s << profile.rejected_by_filter << " matched="s << profile.matched_count
+           << " returned="s << profile.result_count << '\n';
+    const QueryStageTimings& timings = profile.timings;
+    output << "  ns: parse="s << timings.parse.count() << " lookup="s << timings.term_lookup.count()
+           << " scoring="s << timings.scoring.count() << " minus="s << timings.minus_exclusion.count()
+           << " filter="s << timings.filtering.count() << " sort="s << timings.sorting.count()
+           << " total="s << timings.total.count() << '\n';
+    return output;
+}
+
+SlowQueryLog::SlowQueryLog(chrono::nanoseconds threshold, size_t sample_period, size_t capacity)
+        : threshold_(threshold), sample_period_(max<size_t>(1, sample_period)), capacity_(max<size_t>(1, capacity)) {
+}
+
+bool SlowQueryLog::ShouldSample() {
+    const bool sample = request_count_++ % sample_period_ == 0;
+    sampled_count_ += sample;
+    return sample;
+}
+
+bool SlowQueryLog::Record(QueryProfile profile) {
+    if (profile.timings.total < threshold_) {
+        return false;
+    }
+    if (entries_.size() == capacity_) {
+        entries_.pop_front();
+    }
+    entries_.push_back(move(profile));
+    return true;
+}
+
+chrono::nanoseconds SlowQueryLog::GetThreshold() const {
+    return threshold_;
+}
+
+const deque<QueryProfile>& SlowQueryLog::GetEntries() const {
+    return entries_;
+}
+
+size_t SlowQueryLog::GetSampledCount() const {
+    return sampled_count_;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "adaptive_policy.h"
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct TermProfile {
+    std::string word;
+    bool is_minus = false;
+    // 0, если слова нет в индексе.
+    int document_frequency = 0;
+    // Только для плюс-слов.
+    double inverse_document_freq = 0.0;
+    // Сколько вхождений терма пройдено. В режиме ALL списки проходятся галопом, поэтому меньше длины списка.
+    size_t postings_visited = 0;
+};
+
+struct QueryStageTimings {
+    std::chrono::nanoseconds parse{0};
+    std::chrono::nanoseconds term_lookup{0};
+    // Подсчёт релевантности. В режиме ALL включает пересечение, минус-слова и фильтр.
+    std::chrono::nanoseconds scoring{0};
+    std::chrono::nanoseconds minus_exclusion{0};
+    std::chrono::nanoseconds filtering{0};
+    std::chrono::nanoseconds sorting{0};
+    std::chrono::nanoseconds total{0};
+};
+
+// Трасса выполнения одного запроса. Профилируемые запросы выполняются последовательно,
+// чтобы время стадий не смешивалось; suggested_execution - что выбрал бы adaptive_execution.
+struct QueryProfile {
+    std::string raw_query;
+    QueryCostEstimate cost;
+    QueryExecution suggested_execution = QueryExecution::SEQUENTIAL;
+    std::vector<TermProfile> terms;
+    // Документы, набравшие вклад плюс-слов (в режиме ALL - содержащие все плюс-слова).
+    size_t candidate_count = 0;
+    size_t excluded_by_minus = 0;
+    // Отброшенные статусом, рейтингом или предикатом.
+    size_t rejected_by_filter = 0;
+    // Прошедшие все проверки, до обрезки до MAX_RESULT_DOCUMENT_COUNT.
+    size_t matched_count = 0;
+    size_t result_count = 0;
+    QueryStageTimings timings;
+};
+
+// Текстовый вид трассы в духе EXPLAIN: термы по строке, затем счётчики и время стадий.
+std::ostream& operator<<(std::ostream& output, const QueryProfile& profile);
+
+// Журнал медленных запросов. Профилируется каждый sample_period-й запрос, в журнал попадают
+// профилированные запросы не быстрее threshold; хранятся последние capacity записей.
+class SlowQueryLog {
+public:
+    SlowQueryLog(std::chrono::nanoseconds threshold, size_t sample_period, size_t capacity);
+
+    // Отсчитывает запрос и сообщает, нужно ли его профилировать.
+    [[nodiscard]] bool ShouldSample();
+    // Сохраняет трассу, если запрос медленный. Возвращает true, если трасса сохранена.
+    bool Record(QueryProfile profile);
+
+    [[nodiscard]] std::chrono::nanoseconds GetThreshold() const;
+    [[nodiscard]] const std::deque<QueryProfile>& GetEntries() const;
+    [[nodiscard]] size_t GetSampledCount() const;
+
+private:
+    std::chrono::nanoseconds threshold_;
+    size_t sample_period_;
+    size_t capacity_;
+    size_t request_count_ = 0;
+    size_t sampled_count_ = 0;
+    std::deque<QueryProfile> entries_;
+};
@@ -12,13 +12,25 @@ RequestQueue::RequestQueue(SearchServer& search_server):
     }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
-        return FillingDeque (search_server_.FindTopDocuments(raw_query, status));
+        return FindAndRecord(raw_query, status);
     }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
-        return FillingDeque (search_server_.FindTopDocuments(raw_query));
+        return FindAndRecord(raw_query, DocumentStatus::ACTUAL);
     }
 
+void RequestQueue::EnableSlowQueryLog(chrono::nanoseconds threshold, size_t sample_period, size_t capacity) {
+    slow_query_log_.emplace(threshold, sample_period, capacity);
+}
+
+void RequestQueue::DisableSlowQueryLog() {
+    slow_query_log_.reset();
+}
+
+const SlowQueryLog* RequestQueue::GetSlowQueryLog() const {
+    return slow_query_log_ ? &*slow_query_log_ : nullptr;
+}
+
 int RequestQueue::GetNoResultRequests() const {
         return empty_request_count;
     }
@@ -4,6 +4,9 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <chrono>
+#include <optional>
+#include "query_profile.h"
 
 struct QueryResult {
         QueryResult(const std::vector<Document>& result);
@@ -17,11 +20,18 @@ public:
     
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-        return FillingDeque (search_server_.FindTopDocuments(raw_query, document_predicate));
+        return FindAndRecord(raw_query, document_predicate);
     }
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
     std::vector<Document> AddFindRequest(const std::string& raw_query);
     int GetNoResultRequests() const;
+
+    // Каждый sample_period-й запрос выполняется с профилированием, трассы запросов,
+    // выполнявшихся не быстрее threshold, сохраняются в журнале (последние capacity штук).
+    void EnableSlowQueryLog(std::chrono::nanoseconds threshold, size_t sample_period = 1, size_t capacity = 100);
+    void DisableSlowQueryLog();
+    // nullptr, если журнал не включён.
+    [[nodiscard]] const SlowQueryLog* GetSlowQueryLog() const;
     
     
 private:
@@ -30,6 +40,17 @@ private:
     const static int min_in_day_ = 1440;
     SearchServer& search_server_;
     int empty_request_count = 0;
+    std::optional<SlowQueryLog> slow_query_log_;
 
     const std::vector<Document>& FillingDeque(const std::vector<Document>& findTopDocResult);
+
+    template <typename Filter>
+    std::vector<Document> FindAndRecord(const std::string& raw_query, Filter filter) {
+        if (slow_query_log_ && slow_query_log_->ShouldSample()) {
+            ProfiledSearchResult result = search_server_.FindTopDocumentsProfiled(raw_query, filter);
+            slow_query_log_->Record(std::move(result.profile));
+            return FillingDeque(result.documents);
+        }
+        return FillingDeque(search_server_.FindTopDocuments(raw_query, filter));
+    }
 };
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "roaring_bitmap.h"
+
+using namespace std;
+
+RoaringBitmap::RoaringBitmap(const int* document_ids, size_t count) {
+    for (size_t i = 0; i < count;) {
+        Container& container = containers_.emplace_back();
+        container.key = static_cast<uint16_t>(static_cast<size_t>(document_ids[i]) / CONTAINER_SIZE);
+        const size_t base = container.key * CONTAINER_SIZE;
+        for (; i < count && static_cast<size_t>(document_ids[i]) - base < CONTAINER_SIZE; ++i) {
+            container.values.push_back(static_cast<uint16_t>(document_ids[i] - base));
+        }
+        container.cardinality = static_cast<uint32_t>(container.values.size());
+        if (container.cardinality > ARRAY_MAX_SIZE) {
+            MakeDense(container);
+        }
+    }
+}
+
+void RoaringBitmap::Add(int document_id) {
+    const uint16_t key = static_cast<uint16_t>(static_cast<size_t>(document_id) / CONTAINER_SIZE);
+    const uint16_t value = static_cast<uint16_t>(static_cast<size_t>(document_id) % CONTAINER_SIZE);
+    // Id обычно добавляются по возрастанию, тогда нужный блок последний.
+    auto It = !containers_.empty() && containers_.back().key <= key
+              ? containers_.end() - (containers_.back().key == key ? 1 : 0)
+              : lower_bound(containers_.begin(), containers_.end(), key, [](const Container& container, uint16_t key) {
+                  return container.key < key;
+              });
+    if (It == containers_.end() || It->key != key) {
+        It = containers_.insert(It, Container{});
+        It->key = key;
+    }
+    Container& container = *It;
+    if (container.IsDense()) {
+        uint64_t& word = container.words[value / 64];
+        const uint64_t bit = uint64_t{1} << (value % 64);
+        container.cardinality += (word & bit) == 0;
+        word |= bit;
+        return;
+    }
+    const auto position = container.values.empty() || container.values.back() < value
+                          ? container.values.end()
+                          : lower_bound(container.values.begin(), container.values.end(), value);
+    if (position != container.values.end() && *position == value) {
+        return;
+    }
+    container.values.insert(position, value);
+    ++container.cardinality;
+    if (container.cardinality > ARRAY_MAX_SIZE) {
+        MakeDense(container);
+    }
+}
+
+void RoaringBitmap::Remove(int document_id) {
+    const uint16_t key = static_cast<uint16_t>(static_cast<size_t>(document_id) / CONTAINER_SIZE);
+    const uint16_t value = static_cast<uint16_t>(static_cast<size_t>(document_id) % CONTAINER_SIZE);
+    const auto It = lower_bound(containers_.begin(), containers_.end(), key, [](const Container& container, uint16_t key) {
+        return container.key < key;
+    });
+    if (It == containers_.end() || It->key != key) {
+        return;
+    }
+    Container& container = *It;
+    if (container.IsDense()) {
+        uint64_t& word = container.words[value / 64];
+        const uint64_t bit = uint64_t{1} << (value % 64);
+        if ((word & bit) == 0) {
+            return;
+        }
+        word &= ~bit;
+        --container.cardinality;
+        // Обратно в массив с запасом, чтобы блок на границе не перестраивался при каждом изменении.
+        if (container.cardinality < ARRAY_MAX_SIZE / 2) {
+            MakeSparse(container);
+        }
+    } else {
+        const auto position = lower_bound(container.values.begin(), container.values.end(), value);
+        if (position == container.values.end() || *position != value) {
+            return;
+        }
+        container.values.erase(position);
+        --container.cardinality;
+    }
+    if (container.cardinality == 0) {
+        containers_.erase(It);
+    }
+}
+
+bool RoaringBitmap::Contains(int document_id) const {
+    const Container* container = FindContainer(static_cast<uint16_t>(static_cast<size_t>(document_id) / CONTAINER_SIZE));
+    if (container == nullptr) {
+        return false;
+    }
+    const uint16_t value = static_cast<uint16_t>(static_cast<size_t>(document_id) % CONTAINER_SIZE);
+    if (container->IsDense()) {
+        return (container->words[value / 64] >> (value % 64)) & 1;
+    }
+    return binary_search(container->values.begin(), container->values.end(), value);
+}
+
+size_t RoaringBitmap::GetCardinality() const {
+    size_t cardinality = 0;
+    for (const Container& container : containers_) {
+        cardinality += container.cardinality;
+    }
+    return cardinality;
+}
+
+size_t RoaringBitmap::GetMemoryBytes() const {
+    size_t bytes = containers_.capacity() * sizeof(Container);
+    for (const Container& container : containers_) {
+        bytes += container.values.capacity() * sizeof(uint16_t) + container.words.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+size_t RoaringBitmap::EstimateMemoryBytes(const int* document_ids, size_t count) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < count;) {
+        const size_t key = static_cast<size_t>(document_ids[i]) / CONTAINER_SIZE;
+        const size_t begin = i;
+        while (i < count && static_cast<size_t>(document_ids[i]) / CONTAINER_SIZE == key) {
+            ++i;
+        }
+        const size_t cardinality = i - begin;
+        bytes += sizeof(Container) + (cardinality > ARRAY_MAX_SIZE ? CONTAINER_WORDS * sizeof(uint64_t) : cardinality * sizeof(uint16_t));
+    }
+    return bytes;
+}
+
+const RoaringBitmap::Container* RoaringBitmap::FindContainer(uint16_t key) const {
+    const auto It = lower_bound(containers_.begin(), containers_.end(), key, [](const Container& container, uint16_t key) {
+        return container.key < key;
+    });
+    return It != containers_.end() && It->key == key ? &*It : nullptr;
+}
+
+void RoaringBitmap::MakeDense(Container& container) {
+    container.words.assign(CONTAINER_WORDS, 0);
+    for (const uint16_t value : container.values) {
+        container.words[value / 64] |= uint64_t{1} << (value % 64);
+    }
+    container.values = vector<uint16_t>();
+}
+
+void RoaringBitmap::MakeSparse(Container& container) {
+    container.values.clear();
+    container.values.reserve(container.cardinality);
+    for (size_t word = 0; word < CONTAINER_WORDS; ++word) {
+        for (uint64_t bits = container.words[word]; bits != 0; bits &= bits - 1) {
+            container.values.push_back(static_cast<uint16_t>(word * 64 + __builtin_ctzll(bits)));
+        }
+    }
+    container.words = vector<uint64_t>();
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "document_bitmap.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Сжатое множество id документов в духе Roaring. Id делятся на блоки по 65536 по старшим 16 битам.
+// Блок хранит младшие 16 бит отсортированным массивом, пока значений не больше ARRAY_MAX_SIZE,
+// и плотной маской из 1024 слов, когда больше: так блок никогда не занимает больше 8 КБ,
+// а редкие блоки - по 2 байта на id.
+class RoaringBitmap {
+public:
+    RoaringBitmap() = default;
+    // Строит множество из id по возрастанию.
+    RoaringBitmap(const int* document_ids, size_t count);
+
+    void Add(int document_id);
+    void Remove(int document_id);
+
+    [[nodiscard]] bool Contains(int document_id) const;
+    [[nodiscard]] size_t GetCardinality() const;
+    [[nodiscard]] size_t GetMemoryBytes() const;
+    // Сколько памяти заняло бы множество, построенное из id по возрастанию, без его построения.
+    [[nodiscard]] static size_t EstimateMemoryBytes(const int* document_ids, size_t count);
+
+    // Снимает с target документы множества из [begin_id, end_id) и для каждого снятого вызывает on_removed(id).
+    // Плотные блоки снимаются пословно, как AND-NOT масок. Разные потоки могут обрабатывать
+    // непересекающиеся диапазоны, выровненные по 64 id.
+    template <typename Action>
+    void AndNot(DocumentBitmap& target, int begin_id, int end_id, Action on_removed) const;
+
+private:
+    static constexpr size_t CONTAINER_SIZE = 65536;
+    static constexpr size_t CONTAINER_WORDS = CONTAINER_SIZE / 64;
+    static constexpr size_t ARRAY_MAX_SIZE = 4096;
+
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        // Ровно одно из двух не пусто: values у разреженного блока, words у плотного.
+        std::vector<uint16_t> values;
+        std::vector<uint64_t> words;
+
+        [[nodiscard]] bool IsDense() const {
+            return !words.empty();
+        }
+    };
+
+    // Блоки по возрастанию key.
+    std::vector<Container> containers_;
+
+    [[nodiscard]] const Container* FindContainer(uint16_t key) const;
+    static void MakeDense(Container& container);
+    static void MakeSparse(Container& container);
+};
+
+template <typename Action>
+void RoaringBitmap::AndNot(DocumentBitmap& target, int begin_id, int end_id, Action on_removed) const {
+    if (begin_id >= end_id) {
+        return;
+    }
+    const size_t begin = static_cast<size_t>(begin_id);
+    const size_t end = static_cast<size_t>(end_id);
+    auto It = std::lower_bound(containers_.begin(), containers_.end(), begin / CONTAINER_SIZE,
+                               [](const Container& container, size_t key) {
+                                   return container.key < key;
+                               });
+    for (; It != containers_.end() && It->key * CONTAINER_SIZE < end; ++It) {
+        const size_t base = It->key * CONTAINER_SIZE;
+        const size_t local_begin = begin > base ? begin - base : 0;
+        const size_t local_end = std::min(end - base, CONTAINER_SIZE);
+        if (It->IsDense()) {
+            for (size_t word = local_begin / 64; word * 64 < local_end; ++word) {
+                uint64_t mask = It->words[word];
+                if (word * 64 < local_begin) {
+                    mask &= ~uint64_t{0} << (local_begin - word * 64);
+                }
+                if (local_end - word * 64 < 64) {
+                    mask &= (uint64_t{1} << (local_end - word * 64)) - 1;
+                }
+                if (mask == 0) {
+                    continue;
+                }
+                uint64_t removed = target.ExtractWord(base / 64 + word, mask);
+                while (removed != 0) {
+                    on_removed(static_cast<int>(base + word * 64 + __builtin_ctzll(removed)));
+                    removed &= removed - 1;
+                }
+            }
+        } else {
+            const auto first = std::lower_bound(It->values.begin(), It->values.end(), local_begin);
+            for (auto value = first; value != It->values.end() && *value < local_end; ++value) {
+                const size_t document_id = base + *value;
+                if (target.ExtractWord(document_id / 64, uint64_t{1} << (document_id % 64)) != 0) {
+                    on_removed(static_cast<int>(document_id));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,202 @@
+#include "scoring_kernel.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SEARCH_SERVER_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// Пропускает произведение через пустую ассемблерную вставку: компилятор не знает, что в регистре лежит
+// результат умножения, и не может слить его со следующим сложением в FMA. С FMA результат зависел бы
+// от набора инструкций. В отличие от -ffp-contract=off вставка не теряется при встраивании и LTO.
+#if defined(__x86_64__) || defined(__i386__)
+#define KEEP_PRODUCT(value) asm("" : "+v"(value))
+#elif defined(__aarch64__)
+#define KEEP_PRODUCT(value) asm("" : "+w"(value))
+#else
+#define KEEP_PRODUCT(value) asm("" : "+m"(value))
+#endif
+
+namespace {
+
+template <typename TermFreq>
+void AccumulateScalar(const int* document_ids, const TermFreq* term_freqs, size_t count,
+                      double inverse_document_freq, double* accumulator) {
+    for (size_t i = 0; i < count; ++i) {
+        double impact = static_cast<double>(term_freqs[i]) * inverse_document_freq;
+        KEEP_PRODUCT(impact);
+        accumulator[document_ids[i]] += impact;
+    }
+}
+
+#ifdef SEARCH_SERVER_X86_KERNELS
+
+// Маскированные формы с нулевым источником и полной маской: немаскированные gather и cvtps_pd
+// в заголовках GCC берут неинициализированный источник, и -Wextra предупреждает о нём.
+__attribute__((target("avx2")))
+inline __m256d GatherLanes(const double* accumulator, __m128i ids) {
+    const __m256d all_lanes = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), accumulator, ids, all_lanes, 8);
+}
+
+__attribute__((target("avx512f")))
+inline __m512d GatherLanes(const double* accumulator, __m256i ids) {
+    return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), __mmask8{0xFF}, ids, accumulator, 8);
+}
+
+__attribute__((target("avx2")))
+inline void StoreLanes(__m256d values, const int* document_ids, double* accumulator) {
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, values);
+    for (int lane = 0; lane < 4; ++lane) {
+        accumulator[document_ids[lane]] = lanes[lane];
+    }
+}
+
+__attribute__((target("avx2")))
+void AccumulateAvx2(const int* document_ids, const double* term_freqs, size_t count,
+                    double inverse_document_freq, double* accumulator) {
+    const __m256d idf = _mm256_set1_pd(inverse_document_freq);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i ids = _mm_loadu_si128(reinterpret_cast<const __m128i*>(document_ids + i));
+        __m256d impacts = _mm256_mul_pd(_mm256_loadu_pd(term_freqs + i), idf);
+        KEEP_PRODUCT(impacts);
+        const __m256d sums = _mm256_add_pd(GatherLanes(accumulator, ids), impacts);
+        StoreLanes(sums, document_ids + i, accumulator);
+    }
+    AccumulateScalar(document_ids + i, term_freqs + i, count - i, inverse_document_freq, accumulator);
+}
+
+__attribute__((target("avx2")))
+void AccumulateAvx2(const int* document_ids, const float* term_freqs, size_t count,
+                    double inverse_document_freq, double* accumulator) {
+    const __m256d idf = _mm256_set1_pd(inverse_document_freq);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i ids = _mm_loadu_si128(reinterpret_cast<const __m128i*>(document_ids + i));
+        __m256d impacts = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(term_freqs + i)), idf);
+        KEEP_PRODUCT(impacts);
+        const __m256d sums = _mm256_add_pd(GatherLanes(accumulator, ids), impacts);
+        StoreLanes(sums, document_ids + i, accumulator);
+    }
+    AccumulateScalar(document_ids + i, term_freqs + i, count - i, inverse_document_freq, accumulator);
+}
+
+__attribute__((target("avx512f")))
+void AccumulateAvx512(const int* document_ids, const double* term_freqs, size_t count,
+                      double inverse_document_freq, double* accumulator) {
+    const __m512d idf = _mm512_set1_pd(inverse_document_freq);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(document_ids + i));
+        __m512d impacts = _mm512_mul_pd(_mm512_loadu_pd(term_freqs + i), idf);
+        KEEP_PRODUCT(impacts);
+        const __m512d sums = _mm512_add_pd(GatherLanes(accumulator, ids), impacts);
+        _mm512_i32scatter_pd(accumulator, ids, sums, 8);
+    }
+    AccumulateScalar(document_ids + i, term_freqs + i, count - i, inverse_document_freq, accumulator);
+}
+
+__attribute__((target("avx512f")))
+void AccumulateAvx512(const int* document_ids, const float* term_freqs, size_t count,
+                      double inverse_document_freq, double* accumulator) {
+    const __m512d idf = _mm512_set1_pd(inverse_document_freq);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(document_ids + i));
+        __m512d impacts = _mm512_mul_pd(_mm512_maskz_cvtps_pd(__mmask8{0xFF}, _mm256_loadu_ps(term_freqs + i)), idf);
+        KEEP_PRODUCT(impacts);
+        const __m512d sums = _mm512_add_pd(GatherLanes(accumulator, ids), impacts);
+        _mm512_i32scatter_pd(accumulator, ids, sums, 8);
+    }
+    AccumulateScalar(document_ids + i, term_freqs + i, count - i, inverse_document_freq, accumulator);
+}
+
+#endif
+
+bool IsSupported(ScoringKernel kernel) {
+    switch (kernel) {
+        case ScoringKernel::SCALAR:
+            return true;
+#ifdef SEARCH_SERVER_X86_KERNELS
+        case ScoringKernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+        case ScoringKernel::AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+ScoringKernel DetectScoringKernel() {
+#ifdef SEARCH_SERVER_X86_KERNELS
+    __builtin_cpu_init();
+#endif
+    if (IsSupported(ScoringKernel::AVX512)) {
+        return ScoringKernel::AVX512;
+    }
+    if (IsSupported(ScoringKernel::AVX2)) {
+        return ScoringKernel::AVX2;
+    }
+    return ScoringKernel::SCALAR;
+}
+
+ScoringKernel active_kernel = DetectScoringKernel();
+
+}  // namespace
+
+void AccumulateImpacts(const int* document_ids, const double* term_freqs, size_t count,
+                       double inverse_document_freq, double* accumulator) {
+    switch (active_kernel) {
+#ifdef SEARCH_SERVER_X86_KERNELS
+        case ScoringKernel::AVX512:
+            AccumulateAvx512(document_ids, term_freqs, count, inverse_document_freq, accumulator);
+            return;
+        case ScoringKernel::AVX2:
+            AccumulateAvx2(document_ids, term_freqs, count, inverse_document_freq, accumulator);
+            return;
+#endif
+        default:
+            AccumulateScalar(document_ids, term_freqs, count, inverse_document_freq, accumulator);
+    }
+}
+
+void AccumulateImpacts(const int* document_ids, const float* term_freqs, size_t count,
+                       double inverse_document_freq, double* accumulator) {
+    switch (active_kernel) {
+#ifdef SEARCH_SERVER_X86_KERNELS
+        case ScoringKernel::AVX512:
+            AccumulateAvx512(document_ids, term_freqs, count, inverse_document_freq, accumulator);
+            return;
+        case ScoringKernel::AVX2:
+            AccumulateAvx2(document_ids, term_freqs, count, inverse_document_freq, accumulator);
+            return;
+#endif
+        default:
+            AccumulateScalar(document_ids, term_freqs, count, inverse_document_freq, accumulator);
+    }
+}
+
+ScoringKernel GetScoringKernel() {
+    return active_kernel;
+}
+
+const char* GetScoringKernelName(ScoringKernel kernel) {
+    switch (kernel) {
+        case ScoringKernel::AVX512:
+            return "avx512";
+        case ScoringKernel::AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+bool SetScoringKernel(ScoringKernel kernel) {
+    if (!IsSupported(kernel)) {
+        return false;
+    }
+    active_kernel = kernel;
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+
+// Ядро подсчёта релевантности: accumulator[document_ids[i]] += term_freqs[i] * inverse_document_freq.
+// id в одном списке вхождений различны, поэтому векторные версии пишут в accumulator без конфликтов.
+// Реализация выбирается при запуске по возможностям процессора: AVX-512, AVX2 или скалярный цикл.
+// Все версии умножают и складывают отдельными операциями без FMA, поэтому дают побитово одинаковый результат.
+
+enum class ScoringKernel {
+    SCALAR,
+    AVX2,
+    AVX512,
+};
+
+void AccumulateImpacts(const int* document_ids, const double* term_freqs, size_t count,
+                       double inverse_document_freq, double* accumulator);
+
+// Частоты во float32 расширяются до double перед умножением, накопление идёт в double.
+void AccumulateImpacts(const int* document_ids, const float* term_freqs, size_t count,
+                       double inverse_document_freq, double* accumulator);
+
+[[nodiscard]] ScoringKernel GetScoringKernel();
+[[nodiscard]] const char* GetScoringKernelName(ScoringKernel kernel);
+
+// Принудительный выбор реализации, например для сравнения в бенчмарке. Вызывать, пока не идут запросы.
+// Возвращает false и ничего не меняет, если процессор её не поддерживает.
+bool SetScoringKernel(ScoringKernel kernel);
@@ -0,0 +1,326 @@
+#include "search_protocol.h"
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+class ByteWriter {
+public:
+    explicit ByteWriter(string& output)
+            : output_(output), frame_start_(output.size()) {
+        WriteUint32(0);
+    }
+
+    void WriteUint8(uint8_t value) {
+        output_.push_back(static_cast<char>(value));
+    }
+
+    void WriteUint32(uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            output_.push_back(static_cast<char>((value >> shift) & 0xFF));
+        }
+    }
+
+    void WriteInt32(int32_t value) {
+        WriteUint32(static_cast<uint32_t>(value));
+    }
+
+    void WriteDouble(double value) {
+        uint64_t bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+        WriteUint32(static_cast<uint32_t>(bits));
+        WriteUint32(static_cast<uint32_t>(bits >> 32));
+    }
+
+    void WriteString(string_view value) {
+        WriteUint32(static_cast<uint32_t>(value.size()));
+        output_.append(value.data(), value.size());
+    }
+
+    // Записывает длину тела в заголовок кадра.
+    void Finish() {
+        const uint32_t body_size = static_cast<uint32_t>(output_.size() - frame_start_ - FRAME_HEADER_SIZE);
+        for (size_t i = 0; i < FRAME_HEADER_SIZE; ++i) {
+            output_[frame_start_ + i] = static_cast<char>((body_size >> (8 * i)) & 0xFF);
+        }
+    }
+
+private:
+    string& output_;
+    size_t frame_start_;
+};
+
+class ByteReader {
+public:
+    explicit ByteReader(string_view input)
+            : input_(input) {
+    }
+
+    uint8_t ReadUint8() {
+        Require(1);
+        return static_cast<uint8_t>(input_[position_++]);
+    }
+
+    uint32_t ReadUint32() {
+        Require(4);
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(input_[position_++])) << (8 * i);
+        }
+        return value;
+    }
+
+    int32_t ReadInt32() {
+        return static_cast<int32_t>(ReadUint32());
+    }
+
+    double ReadDouble() {
+        const uint64_t low = ReadUint32();
+        const uint64_t high = ReadUint32();
+        const uint64_t bits = low | (high << 32);
+        double value = 0.0;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    string ReadString() {
+        const uint32_t size = ReadUint32();
+        Require(size);
+        string value(input_.substr(position_, size));
+        position_ += size;
+        return value;
+    }
+
+    // Число элементов, каждый из которых занимает не меньше min_element_size байт.
+    uint32_t ReadCount(size_t min_element_size) {
+        const uint32_t count = ReadUint32();
+        Require(static_cast<size_t>(count) * min_element_size);
+        return count;
+    }
+
+    void ExpectEnd() const {
+        if (position_ != input_.size()) {
+            throw ProtocolError("Unexpected trailing bytes in message");
+        }
+    }
+
+private:
+    string_view input_;
+    size_t position_ = 0;
+
+    void Require(size_t size) const {
+        if (input_.size() - position_ < size) {
+            throw ProtocolError("Message is truncated");
+        }
+    }
+};
+
+// Байт прочитан, но не соответствует ни одному значению перечисления.
+class UnknownValueError : public ProtocolError {
+public:
+    using ProtocolError::ProtocolError;
+};
+
+DocumentStatus ReadStatus(ByteReader& reader) {
+    const uint8_t status = reader.ReadUint8();
+    if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+        throw UnknownValueError("Unknown document status");
+    }
+    return static_cast<DocumentStatus>(status);
+}
+
+QueryMode ReadMode(ByteReader& reader) {
+    const uint8_t mode = reader.ReadUint8();
+    if (mode > static_cast<uint8_t>(QueryMode::ALL)) {
+        throw UnknownValueError("Unknown query mode");
+    }
+    return static_cast<QueryMode>(mode);
+}
+
+RequestType ReadType(ByteReader& reader) {
+    const uint8_t type = reader.ReadUint8();
+    if (type < static_cast<uint8_t>(RequestType::FIND) || type > static_cast<uint8_t>(RequestType::UPDATE_ATTRIBUTES)) {
+        throw ProtocolError("Unknown request type");
+    }
+    return static_cast<RequestType>(type);
+}
+
+// Неизвестное значение поля запроса превращается в InvalidRequestError: тип и id уже прочитаны.
+template <typename Read>
+auto ReadRequestField(ByteReader& reader, const Request& request, Read read) {
+    try {
+        return read(reader);
+    } catch (const UnknownValueError& error) {
+        throw InvalidRequestError(request.type, request.request_id, error.what());
+    }
+}
+
+}  // namespace
+
+optional<size_t> PeekFrameBodySize(string_view buffer) {
+    if (buffer.size() < FRAME_HEADER_SIZE) {
+        return nullopt;
+    }
+    size_t body_size = 0;
+    for (size_t i = 0; i < FRAME_HEADER_SIZE; ++i) {
+        body_size |= static_cast<size_t>(static_cast<uint8_t>(buffer[i])) << (8 * i);
+    }
+    if (body_size > MAX_FRAME_BODY_SIZE) {
+        throw ProtocolError("Frame is too large");
+    }
+    return body_size;
+}
+
+void EncodeRequest(const Request& request, string& output) {
+    ByteWriter writer(output);
+    writer.WriteUint8(static_cast<uint8_t>(request.type));
+    writer.WriteUint32(request.request_id);
+    switch (request.type) {
+        case RequestType::FIND:
+            writer.WriteUint8(static_cast<uint8_t>(request.status));
+            writer.WriteUint8(static_cast<uint8_t>(request.mode));
+            writer.WriteString(request.text);
+            break;
+        case RequestType::MATCH:
+            writer.WriteInt32(request.document_id);
+            writer.WriteString(request.text);
+            break;
+        case RequestType::ADD:
+        case RequestType::UPDATE:
+        case RequestType::UPDATE_ATTRIBUTES:
+            writer.WriteInt32(request.document_id);
+            writer.WriteUint8(static_cast<uint8_t>(request.status));
+            writer.WriteUint32(static_cast<uint32_t>(request.ratings.size()));
+            for (const int rating : request.ratings) {
+                writer.WriteInt32(rating);
+            }
+            if (request.type != RequestType::UPDATE_ATTRIBUTES) {
+                writer.WriteString(request.text);
+            }
+            break;
+        case RequestType::REMOVE:
+            writer.WriteInt32(request.document_id);
+            break;
+    }
+    writer.Finish();
+}
+
+Request DecodeRequest(string_view body) {
+    ByteReader reader(body);
+    Request request;
+    request.type = ReadType(reader);
+    request.request_id = reader.ReadUint32();
+    switch (request.type) {
+        case RequestType::FIND:
+            request.status = ReadRequestField(reader, request, ReadStatus);
+            request.mode = ReadRequestField(reader, request, ReadMode);
+            request.text = reader.ReadString();
+            break;
+        case RequestType::MATCH:
+            request.document_id = reader.ReadInt32();
+            request.text = reader.ReadString();
+            break;
+        case RequestType::ADD:
+        case RequestType::UPDATE:
+        case RequestType::UPDATE_ATTRIBUTES: {
+            request.document_id = reader.ReadInt32();
+            request.status = ReadRequestField(reader, request, ReadStatus);
+            const uint32_t rating_count = reader.ReadCount(sizeof(int32_t));
+            request.ratings.reserve(rating_count);
+            for (uint32_t i = 0; i < rating_count; ++i) {
+                request.ratings.push_back(reader.ReadInt32());
+            }
+            if (request.type != RequestType::UPDATE_ATTRIBUTES) {
+                request.text = reader.ReadString();
+            }
+            break;
+        }
+        case RequestType::REMOVE:
+            request.document_id = reader.ReadInt32();
+            break;
+    }
+    reader.ExpectEnd();
+    return request;
+}
+
+void EncodeResponse(const Response& response, string& output) {
+    ByteWriter writer(output);
+    writer.WriteUint8(static_cast<uint8_t>(response.type));
+    writer.WriteUint32(response.request_id);
+    writer.WriteUint8(static_cast<uint8_t>(response.code));
+    if (response.code == ResponseCode::ERROR) {
+        writer.WriteString(response.error);
+        writer.Finish();
+        return;
+    }
+    switch (response.type) {
+        case RequestType::FIND:
+            writer.WriteUint32(static_cast<uint32_t>(response.documents.size()));
+            for (const Document& document : response.documents) {
+                writer.WriteInt32(document.id);
+                writer.WriteDouble(document.relevance);
+                writer.WriteInt32(document.rating);
+            }
+            break;
+        case RequestType::MATCH:
+            writer.WriteUint8(static_cast<uint8_t>(response.status));
+            writer.WriteUint32(static_cast<uint32_t>(response.words.size()));
+            for (const string& word : response.words) {
+                writer.WriteString(word);
+            }
+            break;
+        case RequestType::ADD:
+        case RequestType::REMOVE:
+        case RequestType::UPDATE:
+        case RequestType::UPDATE_ATTRIBUTES:
+            break;
+    }
+    writer.Finish();
+}
+
+Response DecodeResponse(string_view body) {
+    ByteReader reader(body);
+    Response response;
+    response.type = ReadType(reader);
+    response.request_id = reader.ReadUint32();
+    const uint8_t code = reader.ReadUint8();
+    if (code > static_cast<uint8_t>(ResponseCode::ERROR)) {
+        throw ProtocolError("Unknown response code");
+    }
+    response.code = static_cast<ResponseCode>(code);
+    if (response.code == ResponseCode::ERROR) {
+        response.error = reader.ReadString();
+        reader.ExpectEnd();
+        return response;
+    }
+    switch (response.type) {
+        case RequestType::FIND: {
+            const uint32_t document_count = reader.ReadCount(2 * sizeof(int32_t) + sizeof(double));
+            response.documents.reserve(document_count);
+            for (uint32_t i = 0; i < document_count; ++i) {
+                const int id = reader.ReadInt32();
+                const double relevance = reader.ReadDouble();
+                const int rating = reader.ReadInt32();
+                response.documents.emplace_back(id, relevance, rating);
+            }
+            break;
+        }
+        case RequestType::MATCH: {
+            response.status = ReadStatus(reader);
+            const uint32_t word_count = reader.ReadCount(sizeof(uint32_t));
+            response.words.reserve(word_count);
+            for (uint32_t i = 0; i < word_count; ++i) {
+                response.words.push_back(reader.ReadString());
+            }
+            break;
+        }
+        case RequestType::ADD:
+        case RequestType::REMOVE:
+        case RequestType::UPDATE:
+        case RequestType::UPDATE_ATTRIBUTES:
+            break;
+    }
+    reader.ExpectEnd();
+    return response;
+}
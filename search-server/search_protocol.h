@@ -0,0 +1,94 @@
+#pragma once
+#include "document.h"
+#include "search_server.h"
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Бинарный протокол поискового демона. Каждое сообщение - кадр:
+//   uint32 длина тела | тело
+// Тело запроса:  uint8 тип | uint32 id запроса | поля типа
+// Тело ответа:   uint8 тип | uint32 id запроса | uint8 код | поля типа или текст ошибки
+// Числа передаются в little-endian, строки - как uint32 длина и байты.
+// id запроса возвращается в ответе, поэтому клиент может слать запросы конвейером.
+
+enum class RequestType : uint8_t {
+    FIND = 1,
+    MATCH = 2,
+    ADD = 3,
+    REMOVE = 4,
+    // Те же поля, что у ADD.
+    UPDATE = 5,
+    // Как UPDATE, но без текста: меняются только статус и рейтинг.
+    UPDATE_ATTRIBUTES = 6,
+};
+
+enum class ResponseCode : uint8_t {
+    OK = 0,
+    ERROR = 1,
+};
+
+struct Request {
+    RequestType type = RequestType::FIND;
+    uint32_t request_id = 0;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    QueryMode mode = QueryMode::ANY;
+    std::string text;
+    std::vector<int> ratings;
+};
+
+struct Response {
+    RequestType type = RequestType::FIND;
+    uint32_t request_id = 0;
+    ResponseCode code = ResponseCode::OK;
+    std::vector<Document> documents;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<std::string> words;
+    std::string error;
+};
+
+class ProtocolError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Кадр разобран, но значение поля запроса недопустимо. Тип и id запроса известны,
+// поэтому на такой запрос можно ответить ошибкой, не закрывая соединение.
+class InvalidRequestError : public ProtocolError {
+public:
+    InvalidRequestError(RequestType type, uint32_t request_id, const std::string& what)
+            : ProtocolError(what), type_(type), request_id_(request_id) {
+    }
+
+    [[nodiscard]] RequestType GetType() const {
+        return type_;
+    }
+
+    [[nodiscard]] uint32_t GetRequestId() const {
+        return request_id_;
+    }
+
+private:
+    RequestType type_;
+    uint32_t request_id_;
+};
+
+constexpr size_t FRAME_HEADER_SIZE = sizeof(uint32_t);
+constexpr size_t MAX_FRAME_BODY_SIZE = 16 * 1024 * 1024;
+
+// Размер тела первого кадра в буфере или nullopt, если заголовок ещё не пришёл целиком.
+// Бросает ProtocolError, если тело длиннее MAX_FRAME_BODY_SIZE.
+[[nodiscard]] std::optional<size_t> PeekFrameBodySize(std::string_view buffer);
+
+// Дописывают в output готовый кадр.
+void EncodeRequest(const Request& request, std::string& output);
+void EncodeResponse(const Response& response, std::string& output);
+
+// Принимают тело кадра без заголовка. DecodeRequest бросает InvalidRequestError на неизвестный
+// статус или режим поиска и ProtocolError на прочие ошибки разбора.
+[[nodiscard]] Request DecodeRequest(std::string_view body);
+[[nodiscard]] Response DecodeResponse(std::string_view body);
@@ -6,6 +6,8 @@
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <limits>
+#include <tbb/enumerable_thread_specific.h>
 
 using namespace std;
 
@@ -13,6 +15,13 @@ SearchServer::SearchServer(const string& stop_words_text)
         : SearchServer(SplitIntoWords(stop_words_text))  {
 }
 
+StopWordFilter SearchServer::MakeStopWordFilter(const set<string>& stop_words) {
+    for (const string& word : stop_words) {
+        IsValidWord(word);
+    }
+    return StopWordFilter(stop_words);
+}
+
 _Rb_tree_const_iterator<int> SearchServer::begin() const{
     return document_ids_.begin();
 }
@@ -31,48 +40,216 @@ const std::map<std::string_view , double>& SearchServer::GetWordFrequencies(int
 }
 
 
-[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const{
-    return FindTopDocuments(
-            execution::seq,
-            raw_query,
-            [status](int document_id, DocumentStatus document_status, int rating) {
-                return document_status == status;
-            });
+[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status, QueryMode mode) const{
+    return FindTopDocuments(execution::seq, raw_query, DocumentFilter(status), mode);
+}
+
+[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, const DocumentFilter& filter, QueryMode mode) const{
+    return FindTopDocuments(execution::seq, raw_query, filter, mode);
 }
 
 [[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(std::string_view  raw_query) const{
     return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
+BudgetedSearchResult SearchServer::FindTopDocuments(string_view raw_query, chrono::steady_clock::time_point deadline,
+                                                   DocumentStatus status, QueryMode mode) const {
+    return FindTopDocuments(execution::seq, raw_query, deadline, status, mode);
+}
+
+BudgetedSearchResult SearchServer::FindTopDocuments(string_view raw_query, chrono::steady_clock::time_point deadline,
+                                                   const DocumentFilter& filter, QueryMode mode) const {
+    return FindTopDocuments(execution::seq, raw_query, deadline, filter, mode);
+}
+
+BudgetedSearchResult SearchServer::FindTopDocuments(string_view raw_query, chrono::steady_clock::time_point deadline,
+                                                   QueryMode mode) const {
+    return FindTopDocuments(execution::seq, raw_query, deadline, DocumentStatus::ACTUAL, mode);
+}
+
+[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(std::string_view  raw_query, QueryMode mode) const{
+    return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL, mode);
+}
+
 
 void SearchServer::RemoveDocument(int document_id){
+    const int slot = attributes_.FindSlot(document_id);
     for(auto &[word, freq] : document_to_word_frequency_.at(document_id)){
-        word_to_document_frequency_.at(word).erase(document_id);
+        terms_.FindPostings(word)->Erase(slot);
     }
     document_to_word_frequency_.erase(document_id);
     documents_.erase(document_id);
+    attributes_.Remove(document_id);
     document_ids_.erase(document_id);
 }
 
 void SearchServer::AddDocument(int document_id, const string& document, DocumentStatus status,
                                const vector<int>& ratings) {
+    PERF_SCOPE("AddDocument");
+    CheckNewDocumentId(document_id);
+    AddPreparedDocument(PrepareDocument(document_id, document, status, ratings));
+}
+
+PreparedDocument SearchServer::PrepareDocument(int document_id, string_view document, DocumentStatus status,
+                                               const vector<int>& ratings) const {
+    vector<string> words = SplitIntoWordsNoStop(document);
+
+    const double inv_word_count = 1.0 / static_cast<double> (words.size());
+    PreparedDocument prepared{document_id, status, ComputeAverageRating(ratings), {}};
+    for (string& word : words) {
+        prepared.word_frequencies[move(word)] += inv_word_count;
+    }
+    return prepared;
+}
+
+void SearchServer::AddPreparedDocument(PreparedDocument&& document) {
+    CheckNewDocumentId(document.id);
+    InsertDocument(document.id, move(document.word_frequencies), document.status, document.rating);
+}
+
+void SearchServer::InsertDocument(int document_id, map<string, double>&& word_frequencies,
+                                  DocumentStatus status, int rating) {
+    const int slot = attributes_.Add(document_id, status, rating);
+    set<string, less<>> words_in_document;
+    auto& document_word_frequencies = document_to_word_frequency_[document_id];
+    while (!word_frequencies.empty()) {
+        auto node = word_frequencies.extract(word_frequencies.begin());
+        const double term_freq = node.mapped();
+        PostingList& postings = terms_.Insert(node.key());
+        if (postings.empty()) {
+            postings.SetPrecision(term_weight_precision_);
+        }
+        postings.Set(slot, term_freq);
+        const auto It = words_in_document.insert(words_in_document.end(), move(node.key()));
+        document_word_frequencies.emplace_hint(document_word_frequencies.end(), *It, term_freq);
+    }
+    documents_.emplace(document_id, DocumentData{move(words_in_document)});
+    document_ids_.insert(document_id);
+}
+
+void SearchServer::UpdateDocument(int document_id, const string& document, DocumentStatus status,
+                                  const vector<int>& ratings) {
+    CheckExistingDocumentId(document_id);
+    UpdatePreparedDocument(PrepareDocument(document_id, document, status, ratings));
+}
+
+void SearchServer::UpdateDocument(int document_id, DocumentStatus status, const vector<int>& ratings) {
+    CheckExistingDocumentId(document_id);
+    attributes_.Update(document_id, status, ComputeAverageRating(ratings));
+}
+
+void SearchServer::UpdatePreparedDocument(PreparedDocument&& document) {
+    CheckExistingDocumentId(document.id);
+    ReplaceWordFrequencies(document.id, move(document.word_frequencies));
+    attributes_.Update(document.id, document.status, document.rating);
+}
+
+void SearchServer::ReplaceWordFrequencies(int document_id, map<string, double>&& word_frequencies) {
+    auto& words_in_document = documents_.at(document_id).words_;
+    auto& document_word_frequencies = document_to_word_frequency_.at(document_id);
+    const int slot = attributes_.FindSlot(document_id);
+    auto old_It = document_word_frequencies.begin();
+    auto new_It = word_frequencies.begin();
+    while (old_It != document_word_frequencies.end() || new_It != word_frequencies.end()) {
+        const bool only_old = new_It == word_frequencies.end()
+                              || (old_It != document_word_frequencies.end() && old_It->first < new_It->first);
+        if (only_old) {
+            const string_view word = old_It->first;
+            terms_.FindPostings(word)->Erase(slot);
+            old_It = document_word_frequencies.erase(old_It);
+            words_in_document.erase(words_in_document.find(word));
+            continue;
+        }
+        if (old_It == document_word_frequencies.end() || new_It->first < old_It->first) {
+            PostingList& postings = terms_.Insert(new_It->first);
+            if (postings.empty()) {
+                postings.SetPrecision(term_weight_precision_);
+            }
+            postings.Set(slot, new_It->second);
+            const double term_freq = new_It->second;
+            auto node = word_frequencies.extract(new_It++);
+            const auto word_It = words_in_document.insert(move(node.key())).first;
+            document_word_frequencies.emplace_hint(old_It, *word_It, term_freq);
+            continue;
+        }
+        if (old_It->second != new_It->second) {
+            terms_.FindPostings(old_It->first)->Set(slot, new_It->second);
+            old_It->second = new_It->second;
+        }
+        ++old_It;
+        ++new_It;
+    }
+}
+
+void SearchServer::CheckExistingDocumentId(int document_id) const {
+    if (documents_.count(document_id) == 0) {
+        throw invalid_argument("DocumentID "s + to_string(document_id) + " does not exist."s);
+    }
+}
+
+void SearchServer::CheckNewDocumentId(int document_id) const {
     if ((document_id < 0)) {
         throw invalid_argument("DocumentID "s + to_string(document_id) + " is negative."s);
     }
     if(documents_.count(document_id) > 0) {
         throw invalid_argument("DocumentID "s + to_string(document_id) + " already exists."s);
     }
-    vector<string> words = SplitIntoWordsNoStop(document);
+}
 
-    const double inv_word_count = 1.0 / static_cast<double> (words.size());
-    set<string, less<>> words_in_document;
-    for (const string& word : words) {
-        auto [It, success2] = words_in_document.insert(word);
-        word_to_document_frequency_[*It][document_id] += inv_word_count;
-        document_to_word_frequency_[document_id][*It] += inv_word_count;
+void SearchServer::Clear() {
+    terms_.Clear();
+    document_to_word_frequency_.clear();
+    documents_.clear();
+    attributes_ = DocumentAttributes();
+    document_ids_.clear();
+    cold_postings_.reset();
+}
+
+void SearchServer::SaveSnapshot(ostream& output) const {
+    const auto precision = output.precision(numeric_limits<double>::max_digits10);
+    output << document_ids_.size() << '\n';
+    for (const int document_id : document_ids_) {
+        const auto& word_frequencies = document_to_word_frequency_.at(document_id);
+        const int slot = attributes_.FindSlot(document_id);
+        output << document_id << ' ' << static_cast<int>(attributes_.GetStatus(slot)) << ' '
+               << attributes_.GetRating(slot) << ' ' << word_frequencies.size() << '\n';
+        for (const auto& [word, term_freq] : word_frequencies) {
+            output << word << ' ' << term_freq << '\n';
+        }
+    }
+    output.precision(precision);
+}
+
+void SearchServer::LoadSnapshot(istream& input) {
+    size_t document_count = 0;
+    input >> document_count;
+    for (size_t i = 0; i < document_count; ++i) {
+        int document_id = 0;
+        int status = 0;
+        int rating = 0;
+        size_t word_count = 0;
+        input >> document_id >> status >> rating >> word_count;
+        map<string, double> word_frequencies;
+        for (size_t k = 0; k < word_count; ++k) {
+            string word;
+            double term_freq = 0.0;
+            input >> word >> term_freq;
+            word_frequencies.emplace(move(word), term_freq);
+        }
+        if (!input || status < 0 || status >= static_cast<int>(DocumentAttributes::STATUS_COUNT)) {
+            throw invalid_argument("Snapshot is truncated or malformed."s);
+        }
+        CheckNewDocumentId(document_id);
+        InsertDocument(document_id, move(word_frequencies), static_cast<DocumentStatus>(status), rating);
+    }
+}
+
+bool SearchServer::IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < DOUBLE_COMPARISON_ERROR) {
+        return lhs.rating > rhs.rating;
+    } else {
+        return lhs.relevance > rhs.relevance;
     }
-    documents_.emplace(document_id, DocumentData{move(words_in_document),ComputeAverageRating(ratings), status});
-    document_ids_.insert(document_id);
 }
 
 
@@ -80,28 +257,214 @@ int SearchServer::GetDocumentCount() const {
     return static_cast<int>(documents_.size());
 }
 
+int SearchServer::GetDocumentFrequency(string_view word) const {
+    return terms_.Find(word).document_frequency;
+}
+
+void SearchServer::SetCorpusStatistics(const CorpusStatistics* corpus_statistics) {
+    corpus_statistics_ = corpus_statistics;
+}
+
+void SearchServer::SetTermWeightPrecision(TermWeightPrecision precision) {
+    term_weight_precision_ = precision;
+    terms_.ForEach([precision](string_view, PostingList& postings) {
+        postings.SetPrecision(precision);
+    });
+}
+
+void SearchServer::EnableTieredStorage(const TieredStorageOptions& options) {
+    if (options.cold_postings_path.empty()) {
+        throw invalid_argument("Cold postings path is empty."s);
+    }
+    tiered_storage_options_ = options;
+    terms_.SetAccessTracking(true);
+    RebalanceTieredStorage();
+}
+
+void SearchServer::RebalanceTieredStorage() {
+    if (!tiered_storage_options_) {
+        return;
+    }
+    vector<TermDemand> demands;
+    demands.reserve(terms_.size());
+    terms_.ForEachWithAccessCount([&demands](const PostingList& postings, uint64_t access_count) {
+        demands.push_back({access_count, postings.GetHotBytes()});
+    });
+    const vector<bool> hot = ChooseHotTerms(demands, tiered_storage_options_->memory_budget);
+
+    // Пока пишется новый файл, холодные списки ещё читаются из старого.
+    ColdPostingWriter writer(tiered_storage_options_->cold_postings_path);
+    vector<ColdPostingLocation> locations(demands.size());
+    size_t index = 0;
+    terms_.ForEachWithAccessCount([&](PostingList& postings, uint64_t) {
+        if (hot[index]) {
+            postings.MakeHot();
+        } else {
+            locations[index] = writer.Append(postings);
+        }
+        ++index;
+    });
+    shared_ptr<const MappedFile> cold_postings = writer.Finish();
+
+    const char* data = cold_postings->GetData().data();
+    index = 0;
+    terms_.ForEachWithAccessCount([&](PostingList& postings, uint64_t) {
+        if (!hot[index]) {
+            postings.MakeCold(reinterpret_cast<const int*>(data + locations[index].document_ids_offset),
+                              data + locations[index].term_freqs_offset);
+        }
+        ++index;
+    });
+    cold_postings_ = move(cold_postings);
+    terms_.DecayAccessCounts();
+    ++tiered_rebalance_count_;
+}
+
+void SearchServer::DisableTieredStorage() {
+    terms_.ForEach([](string_view, PostingList& postings) {
+        postings.MakeHot();
+    });
+    terms_.SetAccessTracking(false);
+    cold_postings_.reset();
+    tiered_storage_options_.reset();
+}
+
+bool SearchServer::IsTieredStorageEnabled() const {
+    return tiered_storage_options_.has_value();
+}
+
+TieredStorageStats SearchServer::GetTieredStorageStats() const {
+    TieredStorageStats stats;
+    if (tiered_storage_options_) {
+        stats.memory_budget = tiered_storage_options_->memory_budget;
+    }
+    terms_.ForEachWithAccessCount([&stats](const PostingList& postings, uint64_t access_count) {
+        if (postings.IsCold()) {
+            ++stats.cold_term_count;
+            stats.cold_bytes += postings.GetDataBytes();
+            stats.cold_accesses += access_count;
+        } else {
+            ++stats.hot_term_count;
+            stats.hot_bytes += postings.GetHotBytes();
+            stats.hot_accesses += access_count;
+        }
+    });
+    if (cold_postings_) {
+        stats.cold_resident_bytes = cold_postings_->GetResidentBytes();
+    }
+    stats.rebalance_count = tiered_rebalance_count_;
+    return stats;
+}
+
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const string_view raw_query, int document_id) const {
-    Query query = ParseQuery(raw_query);
+    PERF_SCOPE("MatchDocument(seq)");
+    return MatchQuery(ParseQuery(raw_query), document_id);
+}
+
+ProfiledSearchResult SearchServer::FindTopDocumentsProfiled(string_view raw_query, DocumentStatus status, QueryMode mode) const {
+    return FindTopDocumentsProfiled(raw_query, DocumentFilter(status), mode);
+}
+
+ProfiledSearchResult SearchServer::FindTopDocumentsProfiled(string_view raw_query, const DocumentFilter& filter, QueryMode mode) const {
+    DocumentBitmap status_mask_buffer;
+    const DocumentBitmap& status_mask = attributes_.BuildStatusMask(filter, status_mask_buffer);
+    return FindTopDocumentsProfiledImpl(
+            raw_query,
+            [this, &status_mask, &filter](int slot) {
+                return status_mask.Test(slot) && filter.AcceptsRating(attributes_.GetRating(slot));
+            },
+            mode);
+}
+
+ProfiledSearchResult SearchServer::FindTopDocumentsProfiled(string_view raw_query, QueryMode mode) const {
+    return FindTopDocumentsProfiled(raw_query, DocumentStatus::ACTUAL, mode);
+}
+
+ProfiledMatchResult SearchServer::MatchDocumentProfiled(string_view raw_query, int document_id) const {
+    using Clock = chrono::steady_clock;
+    ProfiledMatchResult result;
+    QueryProfile& profile = result.profile;
+    profile.raw_query = string(raw_query);
+
+    const auto start = Clock::now();
+    const Query query = ParseQuery(raw_query);
+    const auto parsed = Clock::now();
+    result.match = MatchQuery(query, document_id);
+    const auto matched = Clock::now();
+    profile.timings.parse = parsed - start;
+    profile.timings.scoring = matched - parsed;
+    profile.timings.total = matched - start;
+
+    // Совпадения ищутся по словам самого документа, списки вхождений не читаются.
+    const auto& word_frequencies = document_to_word_frequency_.at(document_id);
+    profile.candidate_count = 1;
+    profile.excluded_by_minus = any_of(query.minus_words.begin(), query.minus_words.end(), [&word_frequencies](const auto& minus_word) {
+        return word_frequencies.count(minus_word.first) > 0;
+    });
+    profile.matched_count = get<0>(result.match).size();
+    profile.result_count = profile.matched_count;
+    profile.terms = ProfileQueryTerms(query, {}, {});
+    return result;
+}
+
+vector<TermProfile> SearchServer::ProfileQueryTerms(const Query& query, const vector<size_t>& plus_visited,
+                                                    const vector<size_t>& minus_visited) const {
+    vector<TermProfile> terms;
+    terms.reserve(query.plus_words.size() + query.minus_words.size());
+    size_t plus_index = 0;
+    for (const auto& [word, hash] : query.plus_words) {
+        const TermHandle term = terms_.Find(word, hash);
+        TermProfile& profile = terms.emplace_back();
+        profile.word = word;
+        profile.document_frequency = term.document_frequency;
+        if (term.document_frequency > 0) {
+            profile.inverse_document_freq = ComputeWordInverseDocumentFreq(word, term);
+            profile.postings_visited = plus_index < plus_visited.size() ? plus_visited[plus_index] : 0;
+            ++plus_index;
+        }
+    }
+    size_t minus_index = 0;
+    for (const auto& [word, hash] : query.minus_words) {
+        const TermHandle term = terms_.Find(word, hash);
+        TermProfile& profile = terms.emplace_back();
+        profile.word = word;
+        profile.is_minus = true;
+        profile.document_frequency = term.document_frequency;
+        if (term.document_frequency > 0) {
+            profile.postings_visited = minus_index < minus_visited.size() ? minus_visited[minus_index] : 0;
+            ++minus_index;
+        }
+    }
+    return terms;
+}
+
+matched_word_with_status SearchServer::MatchQuery(const Query& query, int document_id) const {
     const auto& words_in_document_with_id = documents_.at(document_id).words_;
+    const int slot = attributes_.FindSlot(document_id);
     vector<string_view> matched_words;
     matched_words.reserve(words_in_document_with_id.size());
-    for (const string& word : query.minus_words) {
-        if (document_to_word_frequency_.at(document_id).count(word)) {
-            return {matched_words, documents_.at(document_id).status};
+    for (const auto& [word, hash] : query.minus_words) {
+        if (ContainsWord(word, hash, slot)) {
+            return {matched_words, attributes_.GetStatus(slot)};
         }
     }
 
-    for (const string& word : query.plus_words) {
+    for (const auto& [word, hash] : query.plus_words) {
         if(words_in_document_with_id.count(word)){
             matched_words.push_back(*words_in_document_with_id.find(word));
         }
     }
 
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, attributes_.GetStatus(slot)};
+}
+
+bool SearchServer::ContainsWord(string_view word, uint64_t hash, int slot) const {
+    const PostingList* postings = terms_.Find(word, hash).postings;
+    return postings != nullptr && postings->Contains(slot);
 }
 
 bool SearchServer::IsStopWord(const string& word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
 void SearchServer::IsValidWord(const string& word) {
@@ -112,7 +475,7 @@ void SearchServer::IsValidWord(const string& word) {
     }
 }
 
-vector<string> SearchServer::SplitIntoWordsNoStop(const string& text) const {
+vector<string> SearchServer::SplitIntoWordsNoStop(const string_view text) const {
     vector<string> words;
     for (const string& word : SplitIntoWords(text)) {
         IsValidWord(word);
@@ -143,27 +506,432 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string text) const {
     if (text.empty() || text[0] == '-') {
         throw invalid_argument("Invalid request. Search term includes two minus or only one minus without other symbols.");
     }
-    return QueryWord{text, is_minus, IsStopWord(text)};
+    const uint64_t hash = HashTerm(text);
+    const bool is_stop = stop_words_.Contains(text, hash);
+    return QueryWord{move(text), hash, is_minus, is_stop};
 }
 
 SearchServer::Query SearchServer::ParseQuery(const string_view text) const {
+    PERF_SCOPE("ParseQuery");
     Query result;
     for (const string& word : SplitIntoWords(text)) {
         QueryWord query_word = ParseQueryWord(word) ;
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
-                result.minus_words.insert(query_word.data);
+                result.minus_words.emplace(move(query_word.data), query_word.hash);
             } else {
-                result.plus_words.insert(query_word.data);
+                result.plus_words.emplace(move(query_word.data), query_word.hash);
             }
         }
     }
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const string& word) const {
-    return log(GetDocumentCount() * 1.0 / static_cast<double>(word_to_document_frequency_.at(word).size()));
+double SearchServer::ComputeWordInverseDocumentFreq(string_view word, const TermHandle& term) const {
+    if (corpus_statistics_) {
+        return log(corpus_statistics_->GetDocumentCount() * 1.0 / static_cast<double>(corpus_statistics_->GetDocumentFrequency(word)));
+    }
+    return log(GetDocumentCount() * 1.0 / static_cast<double>(term.document_frequency));
 }
 
+bool SearchServer::PrepareConjunctiveQuery(const Query& query, ConjunctiveQuery& conjunctive_query) const {
+    if (query.plus_words.empty()) {
+        return false;
+    }
+    for (const auto& [word, hash] : query.plus_words) {
+        const TermHandle term = terms_.Find(word, hash);
+        if (term.document_frequency == 0) {
+            return false;
+        }
+        conjunctive_query.plus_terms.push_back({term.postings, ComputeWordInverseDocumentFreq(word, term)});
+    }
+    for (const auto& [word, hash] : query.minus_words) {
+        const TermHandle term = terms_.Find(word, hash);
+        if (term.document_frequency > 0) {
+            conjunctive_query.minus_postings.push_back(term.postings);
+        }
+    }
+
+    auto& by_size = conjunctive_query.plus_terms_by_size;
+    by_size.resize(conjunctive_query.plus_terms.size());
+    iota(by_size.begin(), by_size.end(), 0);
+    sort(by_size.begin(), by_size.end(), [&conjunctive_query](size_t lhs, size_t rhs) {
+        return conjunctive_query.plus_terms[lhs].postings->size() < conjunctive_query.plus_terms[rhs].postings->size();
+    });
+    return true;
+}
 
+SearchServer::ScoringScratch& SearchServer::GetScoringScratch(size_t document_capacity) {
+    thread_local ScoringScratch scratch;
+    if (scratch.relevance.size() < document_capacity) {
+        scratch.relevance.resize(document_capacity, 0.0);
+    }
+    scratch.candidates.Reserve(document_capacity);
+    return scratch;
+}
+
+SearchServer::ResolvedQuery SearchServer::ResolveQuery(const Query& query) const {
+    ResolvedQuery resolved_query;
+    for (const auto& [word, hash] : query.plus_words) {
+        const TermHandle term = terms_.Find(word, hash);
+        if (term.document_frequency > 0) {
+            resolved_query.plus_terms.push_back({term.postings, ComputeWordInverseDocumentFreq(word, term)});
+        }
+    }
+    for (const auto& [word, hash] : query.minus_words) {
+        const TermHandle term = terms_.Find(word, hash);
+        if (term.document_frequency > 0) {
+            resolved_query.minus_postings.push_back(term.postings);
+        }
+    }
+    return resolved_query;
+}
+
+void SearchServer::AccumulateTerm(const ScoredTerm& term, int begin_id, int end_id, ScoringScratch& scratch) {
+    const PostingList& postings = *term.postings;
+    const size_t begin = postings.Gallop(0, begin_id);
+    AccumulatePostings(term, begin, postings.Gallop(begin, end_id), scratch);
+}
+
+void SearchServer::AccumulatePostings(const ScoredTerm& term, size_t begin, size_t end, ScoringScratch& scratch) {
+    const PostingList& postings = *term.postings;
+    postings.AccumulateImpacts(begin, end, term.inverse_document_freq, scratch.relevance.data());
+    for (size_t i = begin; i < end; ++i) {
+        scratch.candidates.Set(postings.DocumentIdAt(i));
+    }
+}
 
+size_t SearchServer::AccumulatePostingsWithin(const ScoredTerm& term, size_t begin, size_t end, ScoringScratch& scratch,
+                                              DeadlineSignal& signal) {
+    size_t done = 0;
+    for (; begin < end && !signal.IsExpired(); begin += DEADLINE_CHECK_POSTINGS) {
+        const size_t chunk_end = min(begin + DEADLINE_CHECK_POSTINGS, end);
+        AccumulatePostings(term, begin, chunk_end, scratch);
+        done += chunk_end - begin;
+    }
+    return done;
+}
+
+vector<size_t> SearchServer::OrderByImpact(const vector<ScoredTerm>& plus_terms) {
+    vector<size_t> order(plus_terms.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&plus_terms](size_t lhs, size_t rhs) {
+        return plus_terms[lhs].inverse_document_freq > plus_terms[rhs].inverse_document_freq;
+    });
+    return order;
+}
+
+int SearchServer::GetParallelRangeSize(int document_capacity) {
+    constexpr int MIN_RANGE_SIZE = 4096;
+    const int max_range_count = 4 * static_cast<int>(max(1u, thread::hardware_concurrency()));
+    const int range_size = max(MIN_RANGE_SIZE, (document_capacity + max_range_count - 1) / max_range_count);
+    return (range_size + 63) / 64 * 64;
+}
+
+void SearchServer::ExcludeMinusPostings(const vector<const PostingList*>& minus_postings, int begin_id, int end_id,
+                                        ScoringScratch& scratch) {
+    for (const PostingList* postings : minus_postings) {
+        // Длинный список снимается пословно, и обнулять релевантность нужно только у снятых кандидатов.
+        if (const RoaringBitmap* bitmap = postings->GetBitmap()) {
+            bitmap->AndNot(scratch.candidates, begin_id, end_id, [&scratch](int document_id) {
+                scratch.relevance[document_id] = 0.0;
+            });
+            continue;
+        }
+        const size_t begin = postings->Gallop(0, begin_id);
+        const size_t end = postings->Gallop(begin, end_id);
+        for (size_t i = begin; i < end; ++i) {
+            const int document_id = postings->DocumentIdAt(i);
+            scratch.candidates.Reset(document_id);
+            scratch.relevance[document_id] = 0.0;
+        }
+    }
+}
+
+void SearchServer::PrepareBatchScratch(BatchScratch& scratch, size_t document_capacity, size_t slot_count) {
+    if (scratch.relevance.size() < document_capacity * slot_count) {
+        scratch.relevance.resize(document_capacity * slot_count, 0.0);
+    }
+    if (scratch.candidates.size() < slot_count) {
+        scratch.candidates.resize(slot_count);
+        scratch.excluded.resize(slot_count);
+    }
+    for (size_t slot = 0; slot < slot_count; ++slot) {
+        scratch.candidates[slot].Reserve(document_capacity);
+        scratch.excluded[slot].Reserve(document_capacity);
+    }
+}
+
+size_t SearchServer::GetBatchGroupSize(size_t document_capacity) {
+    constexpr size_t BATCH_SCRATCH_BYTES = size_t{8} << 20;
+    constexpr size_t MAX_BATCH_GROUP_SIZE = 64;
+    const size_t row_bytes = max<size_t>(1, document_capacity) * sizeof(double);
+    return clamp<size_t>(BATCH_SCRATCH_BYTES / row_bytes, 1, MAX_BATCH_GROUP_SIZE);
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string>& raw_queries, DocumentStatus status,
+                                                             BatchScanStats* stats) const {
+    vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for (const string& raw_query : raw_queries) {
+        queries.push_back(ParseQuery(raw_query));
+    }
+
+    // Ключ группировки - плюс-слово запроса с самым длинным списком: запросы с общим ключом
+    // оказываются рядом и читают самый дорогой список один раз.
+    vector<BatchQuery> batch_queries(queries.size());
+    vector<pair<string_view, size_t>> keyed_queries;
+    size_t postings_read_independent = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        BatchQuery& batch_query = batch_queries[i];
+        string_view key;
+        int key_frequency = 0;
+        for (const auto& [word, hash] : queries[i].plus_words) {
+            const TermHandle term = terms_.Find(word, hash);
+            if (term.document_frequency == 0) {
+                continue;
+            }
+            batch_query.plus_terms.push_back({word, term});
+            postings_read_independent += term.document_frequency;
+            if (term.document_frequency > key_frequency) {
+                key = word;
+                key_frequency = term.document_frequency;
+            }
+        }
+        for (const auto& [word, hash] : queries[i].minus_words) {
+            const TermHandle term = terms_.Find(word, hash);
+            if (term.document_frequency > 0) {
+                batch_query.minus_terms.push_back({word, term});
+                postings_read_independent += term.document_frequency;
+            }
+        }
+        if (key_frequency > 0) {
+            keyed_queries.emplace_back(key, i);
+        }
+    }
+    sort(keyed_queries.begin(), keyed_queries.end());
+
+    // Группа - запросы с общим ключом, поровну поделённые на части не больше GetBatchGroupSize.
+    // Запрос, ключ которого ни с кем не совпал, не делит с другими даже самый длинный список
+    // и выполняется отдельно, как FindTopDocuments.
+    const size_t max_group_size = GetBatchGroupSize(attributes_.GetCapacity());
+    vector<vector<size_t>> groups;
+    for (size_t begin = 0; begin < keyed_queries.size();) {
+        size_t end = begin + 1;
+        while (end < keyed_queries.size() && keyed_queries[end].first == keyed_queries[begin].first) {
+            ++end;
+        }
+        const size_t part_count = (end - begin + max_group_size - 1) / max_group_size;
+        for (size_t part = 0; part < part_count; ++part) {
+            vector<size_t>& group = groups.emplace_back();
+            for (size_t k = begin + (end - begin) * part / part_count; k < begin + (end - begin) * (part + 1) / part_count; ++k) {
+                group.push_back(keyed_queries[k].second);
+            }
+        }
+        begin = end;
+    }
+
+    const DocumentFilter filter(status);
+    DocumentBitmap status_mask_buffer;
+    const DocumentBitmap& status_mask = attributes_.BuildStatusMask(filter, status_mask_buffer);
+    vector<vector<Document>> results(raw_queries.size());
+    vector<size_t> group_postings_read(groups.size(), 0);
+    vector<size_t> group_indexes(groups.size());
+    iota(group_indexes.begin(), group_indexes.end(), 0);
+    // Накопители групп живут только до конца пакета, а не в каждом рабочем потоке TBB до его завершения.
+    tbb::enumerable_thread_specific<BatchScratch> batch_scratches;
+    for_each(execution::par, group_indexes.begin(), group_indexes.end(),
+             [&](size_t group_index) {
+                 const vector<size_t>& group = groups[group_index];
+                 group_postings_read[group_index] = group.size() == 1
+                         ? ScoreBatchQuery(batch_queries[group[0]], filter, status_mask, results[group[0]])
+                         : ScoreBatchGroup(batch_queries, group, filter, status_mask, batch_scratches.local(), results);
+             });
+
+    if (stats) {
+        stats->query_count = queries.size();
+        stats->group_count = groups.size();
+        stats->independent_count = count_if(groups.begin(), groups.end(), [](const vector<size_t>& group) {
+            return group.size() == 1;
+        });
+        stats->postings_read = accumulate(group_postings_read.begin(), group_postings_read.end(), size_t{0});
+        stats->postings_read_independent = postings_read_independent;
+    }
+    return results;
+}
+
+// Слова группы обходятся в лексикографическом порядке, то есть для каждого запроса в порядке его plus_words,
+// поэтому суммы релевантности складываются так же, как в FindAllDocuments, и совпадают побитово.
+// Минус-слова отмечаются в excluded в том же проходе и применяются при сборе кандидатов.
+size_t SearchServer::ScoreBatchQuery(const BatchQuery& query, const DocumentFilter& filter, const DocumentBitmap& status_mask,
+                                     vector<Document>& result) const {
+    ResolvedQuery resolved_query;
+    size_t postings_read = 0;
+    for (const BatchQueryTerm& query_term : query.plus_terms) {
+        resolved_query.plus_terms.push_back({query_term.term.postings, ComputeWordInverseDocumentFreq(query_term.word, query_term.term)});
+        postings_read += query_term.term.postings->size();
+    }
+    for (const BatchQueryTerm& query_term : query.minus_terms) {
+        resolved_query.minus_postings.push_back(query_term.term.postings);
+        postings_read += query_term.term.postings->size();
+    }
+    result = FindAllDocuments(resolved_query, [this, &status_mask, &filter](int slot) {
+        return status_mask.Test(slot) && filter.AcceptsRating(attributes_.GetRating(slot));
+    });
+    sort(result.begin(), result.end(), IsMoreRelevant);
+    if (result.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        result.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return postings_read;
+}
+
+size_t SearchServer::ScoreBatchGroup(const vector<BatchQuery>& queries, const vector<size_t>& group, const DocumentFilter& filter,
+                                     const DocumentBitmap& status_mask, BatchScratch& scratch,
+                                     vector<vector<Document>>& results) const {
+    struct BatchTerm {
+        TermHandle term;
+        vector<uint32_t> plus_slots;
+        vector<uint32_t> minus_slots;
+    };
+    map<string_view, BatchTerm> group_terms;
+    for (uint32_t slot = 0; slot < group.size(); ++slot) {
+        for (const BatchQueryTerm& query_term : queries[group[slot]].plus_terms) {
+            BatchTerm& batch_term = group_terms[query_term.word];
+            batch_term.term = query_term.term;
+            batch_term.plus_slots.push_back(slot);
+        }
+        for (const BatchQueryTerm& query_term : queries[group[slot]].minus_terms) {
+            BatchTerm& batch_term = group_terms[query_term.word];
+            batch_term.term = query_term.term;
+            batch_term.minus_slots.push_back(slot);
+        }
+    }
+
+    const size_t capacity = attributes_.GetCapacity();
+    const size_t slot_count = group.size();
+    PrepareBatchScratch(scratch, capacity, slot_count);
+    double* relevance = scratch.relevance.data();
+    size_t postings_read = 0;
+    for (const auto& [word, batch_term] : group_terms) {
+        const TermHandle& term = batch_term.term;
+        const PostingList& postings = *term.postings;
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word, term);
+        postings_read += postings.size();
+        for (size_t begin = 0; begin < postings.size(); begin += BATCH_CHUNK_SIZE) {
+            const size_t end = min(begin + BATCH_CHUNK_SIZE, postings.size());
+            for (const uint32_t slot : batch_term.plus_slots) {
+                postings.AccumulateImpacts(begin, end, inverse_document_freq, relevance + slot * capacity);
+                for (size_t i = begin; i < end; ++i) {
+                    scratch.candidates[slot].Set(postings.DocumentIdAt(i));
+                }
+            }
+            for (const uint32_t slot : batch_term.minus_slots) {
+                for (size_t i = begin; i < end; ++i) {
+                    scratch.excluded[slot].Set(postings.DocumentIdAt(i));
+                }
+            }
+        }
+    }
+
+    const int end_id = static_cast<int>(capacity);
+    vector<Document>& matched_documents = scratch.matched_documents;
+    for (size_t slot = 0; slot < slot_count; ++slot) {
+        const DocumentBitmap& excluded = scratch.excluded[slot];
+        matched_documents.clear();
+        scratch.candidates[slot].ExtractEach(0, end_id, [&](int document_slot) {
+            double& document_relevance = relevance[slot * capacity + document_slot];
+            const double value = document_relevance;
+            document_relevance = 0.0;
+            if (!excluded.Test(document_slot) && status_mask.Test(document_slot)
+                && filter.AcceptsRating(attributes_.GetRating(document_slot))) {
+                matched_documents.emplace_back(attributes_.GetDocumentId(document_slot), value,
+                                               attributes_.GetRating(document_slot));
+            }
+        });
+        scratch.excluded[slot].ExtractEach(0, end_id, [](int) {});
+
+        sort(matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
+        const size_t result_count = min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+        results[group[slot]].assign(matched_documents.begin(), matched_documents.begin() + result_count);
+    }
+    return postings_read;
+}
+
+SearchServer::QueryPlan SearchServer::PlanQuery(const Query& query, QueryMode mode) const {
+    QueryPlan plan;
+    plan.mode = mode;
+    QueryCostEstimate& cost = plan.cost;
+    cost.document_capacity = attributes_.GetCapacity();
+    cost.conjunctive = mode == QueryMode::ALL;
+    if (mode == QueryMode::ALL) {
+        plan.has_matches = PrepareConjunctiveQuery(query, plan.conjunctive_query);
+        if (!plan.has_matches) {
+            return plan;
+        }
+        const auto& plus_terms = plan.conjunctive_query.plus_terms;
+        const size_t rarest_size = plus_terms[plan.conjunctive_query.plus_terms_by_size[0]].postings->size();
+        cost.plus_term_count = plus_terms.size();
+        cost.plus_postings = rarest_size * plus_terms.size();
+        cost.max_term_postings = plus_terms[plan.conjunctive_query.plus_terms_by_size.back()].postings->size();
+        cost.minus_term_count = plan.conjunctive_query.minus_postings.size();
+        for (const PostingList* postings : plan.conjunctive_query.minus_postings) {
+            cost.minus_postings += min(rarest_size, postings->size());
+        }
+        return plan;
+    }
+
+    plan.resolved_query = ResolveQuery(query);
+    cost.plus_term_count = plan.resolved_query.plus_terms.size();
+    for (const ScoredTerm& term : plan.resolved_query.plus_terms) {
+        cost.plus_postings += term.postings->size();
+        cost.max_term_postings = max(cost.max_term_postings, term.postings->size());
+    }
+    cost.minus_term_count = plan.resolved_query.minus_postings.size();
+    for (const PostingList* postings : plan.resolved_query.minus_postings) {
+        cost.minus_postings += postings->size();
+    }
+    return plan;
+}
+
+AdaptivePolicyThresholds SearchServer::GetAdaptivePolicyThresholds() const {
+    return policy_selector_.GetThresholds();
+}
+
+void SearchServer::SetAdaptivePolicyThresholds(const AdaptivePolicyThresholds& thresholds) {
+    policy_selector_.SetThresholds(thresholds);
+}
+
+AdaptivePolicyThresholds SearchServer::CalibrateAdaptivePolicy(const vector<string>& queries, QueryMode mode) {
+    constexpr int REPETITION_COUNT = 3;
+    const auto accept_all = [](int) {
+        return true;
+    };
+    vector<CalibrationSample> samples;
+    samples.reserve(queries.size());
+    for (const string& raw_query : queries) {
+        QueryPlan plan = PlanQuery(ParseQuery(raw_query), mode);
+        CalibrationSample sample{plan.cost, {}};
+        for (size_t execution = 0; execution < QUERY_EXECUTION_COUNT; ++execution) {
+            plan.execution = static_cast<QueryExecution>(execution);
+            chrono::nanoseconds best_latency = chrono::nanoseconds::max();
+            for (int repetition = 0; repetition < REPETITION_COUNT; ++repetition) {
+                const auto start = chrono::steady_clock::now();
+                const vector<Document> matched_documents = ExecuteQueryPlan(plan, accept_all);
+                best_latency = min<chrono::nanoseconds>(best_latency, chrono::steady_clock::now() - start);
+            }
+            sample.latency[execution] = best_latency;
+        }
+        samples.push_back(sample);
+    }
+    const AdaptivePolicyThresholds thresholds = AdaptivePolicySelector::FitThresholds(samples, policy_selector_.GetThresholds());
+    policy_selector_.SetThresholds(thresholds);
+    return thresholds;
+}
+
+vector<PolicyDecision> SearchServer::GetPolicyDecisions() const {
+    return policy_selector_.GetDecisions();
+}
+
+PolicyStats SearchServer::GetPolicyStats() const {
+    return policy_selector_.GetStats();
+}
@@ -9,20 +9,86 @@
 #include <execution>
 #include "log_duration.h"
 #include "concurrent_map.h"
+#include <numeric>
+#include <thread>
+#include "posting_list.h"
+#include "document_attributes.h"
+#include "term_table.h"
+#include "stop_word_filter.h"
+#include "adaptive_policy.h"
+#include "query_profile.h"
+#include "tiered_storage.h"
+#include "perf_counters.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <tbb/task_arena.h>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 using vector_string_view = std::vector<std::string_view>;
 using matched_word_with_status = std::tuple<vector_string_view, DocumentStatus>;
 
+struct ProfiledSearchResult {
+    std::vector<Document> documents;
+    QueryProfile profile;
+};
+
+// Результат поиска с ограничением по времени.
+struct BudgetedSearchResult {
+    std::vector<Document> documents;
+    // true, если срок истёк раньше, чем пройдены все списки вхождений плюс-слов.
+    bool partial = false;
+    // Доля пройденных вхождений плюс-слов, в режиме ALL - вхождений самого редкого плюс-слова.
+    double completed_fraction = 1.0;
+};
+
+struct ProfiledMatchResult {
+    matched_word_with_status match;
+    QueryProfile profile;
+};
+
+// Счётчики пакетного выполнения FindTopDocumentsBatch. postings_read - сколько вхождений прочитано:
+// каждый список один раз на группу запросов; postings_read_independent - сколько прочитали бы
+// те же запросы, выполненные по отдельности. independent_count - группы из одного запроса,
+// которому не с кем делить списки: он выполняется как обычный FindTopDocuments.
+struct BatchScanStats {
+    size_t query_count = 0;
+    size_t group_count = 0;
+    size_t independent_count = 0;
+    size_t postings_read = 0;
+    size_t postings_read_independent = 0;
+};
+
+// ANY - документ подходит, если содержит хотя бы одно плюс-слово, ALL - если содержит все плюс-слова.
+enum class QueryMode {
+    ANY,
+    ALL,
+};
+
+// Статистика корпуса для IDF. По умолчанию сервер считает её по собственному индексу,
+// но может использовать внешнюю, например общую для нескольких шардов.
+class CorpusStatistics {
+public:
+    virtual ~CorpusStatistics() = default;
+    [[nodiscard]] virtual int GetDocumentCount() const = 0;
+    [[nodiscard]] virtual int GetDocumentFrequency(std::string_view word) const = 0;
+};
+
+// Документ, уже разобранный на слова с частотами. Готовится вне сервера, например в другом потоке.
+struct PreparedDocument {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    int rating = 0;
+    std::map<std::string, double> word_frequencies;
+};
+
 class SearchServer {
 public:
 
     template <typename StringContainer>
     explicit SearchServer(const StringContainer& stop_words)
-            : stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
-        for(const std::string& word: stop_words_){
-            IsValidWord(word);
-        }
+            : stop_words_(MakeStopWordFilter(MakeUniqueNonEmptyStrings(stop_words))) {
     }
 
     explicit SearchServer(const std::string& stop_words_text);
@@ -30,28 +96,130 @@ public:
     void AddDocument(int document_id, const std::string& document, DocumentStatus status,
                      const std::vector<int>& ratings);
 
+    // Разбивает текст на слова без стоп-слов и считает частоты. Читает только стоп-слова, поэтому
+    // может вызываться из других потоков, пока индекс меняется через AddPreparedDocument.
+    [[nodiscard]] PreparedDocument PrepareDocument(int document_id, std::string_view document, DocumentStatus status,
+                                                   const std::vector<int>& ratings) const;
+    void AddPreparedDocument(PreparedDocument&& document);
+
+    // Заменяет текст, статус и рейтинг существующего документа на месте. Списки вхождений меняются только
+    // у слов, которые появились, пропали или поменяли частоту; документ не пропадает из индекса.
+    void UpdateDocument(int document_id, const std::string& document, DocumentStatus status,
+                        const std::vector<int>& ratings);
+    // Меняет только статус и рейтинг, индекс слов не трогается.
+    void UpdateDocument(int document_id, DocumentStatus status, const std::vector<int>& ratings);
+    void UpdatePreparedDocument(PreparedDocument&& document);
+
     template <typename DocumentPredicate>
-    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                         QueryMode mode = QueryMode::ANY) const;
 
     template <typename ExecutionPolicy, typename DocumentPredicate>
-    [[nodiscard]] std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    [[nodiscard]] std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+                                                         QueryMode mode = QueryMode::ANY) const;
+
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view  raw_query, DocumentStatus status,
+                                                         QueryMode mode = QueryMode::ANY) const;
+
+    template<typename ExecutionPolicy>
+    [[nodiscard]] std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view  raw_query, DocumentStatus status,
+                                                         QueryMode mode = QueryMode::ANY) const;
+
 
-    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view  raw_query, DocumentStatus status) const;
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter,
+                                                         QueryMode mode = QueryMode::ANY) const;
 
     template<typename ExecutionPolicy>
-    [[nodiscard]] std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view  raw_query, DocumentStatus status) const;
+    [[nodiscard]] std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentFilter& filter,
+                                                         QueryMode mode = QueryMode::ANY) const;
 
 
     [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, QueryMode mode) const;
     template<typename ExecutionPolicy>
     [[nodiscard]] std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view  raw_query) const;
-
+    template<typename ExecutionPolicy>
+    [[nodiscard]] std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view  raw_query, QueryMode mode) const;
+
+
+    // Пакет запросов в режиме ANY с общим сканированием: запросы группируются по общим словам, и список
+    // вхождений каждого слова читается один раз на группу. Результат совпадает с FindTopDocuments(query, status)
+    // для каждого запроса по отдельности.
+    [[nodiscard]] std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+                                                                           DocumentStatus status = DocumentStatus::ACTUAL,
+                                                                           BatchScanStats* stats = nullptr) const;
+
+    // Поиск со сроком: после deadline вычисление останавливается и возвращаются лучшие документы по уже
+    // пройденной части списков. В режиме ANY плюс-слова проходятся по убыванию IDF - сначала самые весомые
+    // и короткие списки, в режиме ALL проходится часть самого редкого списка. Минус-слова учитываются
+    // полностью всегда, чтобы в частичный результат не попали исключённые документы. Из-за другого порядка
+    // слов релевантность полного результата может отличаться от FindTopDocuments в последних битах.
+    [[nodiscard]] BudgetedSearchResult FindTopDocuments(std::string_view raw_query, std::chrono::steady_clock::time_point deadline,
+                                                        DocumentStatus status = DocumentStatus::ACTUAL,
+                                                        QueryMode mode = QueryMode::ANY) const;
+    [[nodiscard]] BudgetedSearchResult FindTopDocuments(std::string_view raw_query, std::chrono::steady_clock::time_point deadline,
+                                                        const DocumentFilter& filter, QueryMode mode = QueryMode::ANY) const;
+    [[nodiscard]] BudgetedSearchResult FindTopDocuments(std::string_view raw_query, std::chrono::steady_clock::time_point deadline,
+                                                        QueryMode mode) const;
+
+    template <typename ExecutionPolicy>
+    [[nodiscard]] BudgetedSearchResult FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                                        std::chrono::steady_clock::time_point deadline,
+                                                        DocumentStatus status = DocumentStatus::ACTUAL,
+                                                        QueryMode mode = QueryMode::ANY) const;
+    template <typename ExecutionPolicy>
+    [[nodiscard]] BudgetedSearchResult FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                                        std::chrono::steady_clock::time_point deadline,
+                                                        const DocumentFilter& filter, QueryMode mode = QueryMode::ANY) const;
+    template <typename ExecutionPolicy>
+    [[nodiscard]] BudgetedSearchResult FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                                        std::chrono::steady_clock::time_point deadline, QueryMode mode) const;
 
     [[nodiscard]] matched_word_with_status MatchDocument(std::string_view raw_query, int document_id) const;
     template<typename ExecutionPolicy>
     [[nodiscard]] matched_word_with_status MatchDocument(const ExecutionPolicy& policy, std::string_view raw_query, int document_id) const;
 
+    // Профилируемые варианты: выполняются последовательно и возвращают трассу запроса рядом с результатом.
+    template <typename DocumentPredicate>
+    [[nodiscard]] ProfiledSearchResult FindTopDocumentsProfiled(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                                QueryMode mode = QueryMode::ANY) const;
+    [[nodiscard]] ProfiledSearchResult FindTopDocumentsProfiled(std::string_view raw_query, DocumentStatus status,
+                                                                QueryMode mode = QueryMode::ANY) const;
+    [[nodiscard]] ProfiledSearchResult FindTopDocumentsProfiled(std::string_view raw_query, const DocumentFilter& filter,
+                                                                QueryMode mode = QueryMode::ANY) const;
+    [[nodiscard]] ProfiledSearchResult FindTopDocumentsProfiled(std::string_view raw_query, QueryMode mode = QueryMode::ANY) const;
+    [[nodiscard]] ProfiledMatchResult MatchDocumentProfiled(std::string_view raw_query, int document_id) const;
+
     [[nodiscard]] int GetDocumentCount() const;
+    [[nodiscard]] int GetDocumentFrequency(std::string_view word) const;
+
+    // Статистика должна жить дольше сервера. nullptr возвращает статистику по собственному индексу.
+    void SetCorpusStatistics(const CorpusStatistics* corpus_statistics);
+
+    // Переводит частоты всех термов, в том числе добавляемых позже, в заданную точность.
+    void SetTermWeightPrecision(TermWeightPrecision precision);
+
+    // Многоуровневое хранение списков вхождений. Включение начинает считать обращения к термам и сразу
+    // раскладывает списки по уровням; дальше раскладка обновляется RebalanceTieredStorage по накопленным
+    // обращениям. Запросы читают холодные списки из отображённого файла так же, как горячие из памяти.
+    // Изменение холодного списка (AddDocument, RemoveDocument, SetTermWeightPrecision) возвращает его
+    // в память до следующей перестановки, поэтому между перестановками бюджет может быть превышен.
+    void EnableTieredStorage(const TieredStorageOptions& options);
+    void RebalanceTieredStorage();
+    // Возвращает все списки в память и перестаёт считать обращения.
+    void DisableTieredStorage();
+    [[nodiscard]] bool IsTieredStorageEnabled() const;
+    [[nodiscard]] TieredStorageStats GetTieredStorageStats() const;
+
+    // Пороги, по которым FindTopDocuments с adaptive_execution выбирает способ выполнения.
+    [[nodiscard]] AdaptivePolicyThresholds GetAdaptivePolicyThresholds() const;
+    void SetAdaptivePolicyThresholds(const AdaptivePolicyThresholds& thresholds);
+    // Выполняет запросы каждым способом, подбирает пороги по замерам, устанавливает и возвращает их.
+    AdaptivePolicyThresholds CalibrateAdaptivePolicy(const std::vector<std::string>& queries, QueryMode mode = QueryMode::ANY);
+    // Выборка последних решений adaptive_execution с измеренной задержкой (см. AdaptivePolicySelector)
+    // и сводка по способам выполнения.
+    [[nodiscard]] std::vector<PolicyDecision> GetPolicyDecisions() const;
+    [[nodiscard]] PolicyStats GetPolicyStats() const;
 
     [[nodiscard]] std::_Rb_tree_const_iterator<int> begin() const;
     [[nodiscard]] std::_Rb_tree_const_iterator<int> end() const;
@@ -63,115 +231,556 @@ public:
     template<typename ExecutionPolicy>
     void RemoveDocument(const ExecutionPolicy& policy, int document_id);
 
+    void Clear();
+
+    // Снимок индекса: id, статус, рейтинг и частоты слов каждого документа в текстовом виде.
+    void SaveSnapshot(std::ostream& output) const;
+    // Добавляет документы из снимка к уже проиндексированным.
+    void LoadSnapshot(std::istream& input);
+
+    [[nodiscard]] static bool IsMoreRelevant(const Document& lhs, const Document& rhs);
 
 
 private:
     struct DocumentData {
         std::set <std::string, std::less<>> words_;
-        int rating;
-        DocumentStatus status;
     };
 
     static constexpr double DOUBLE_COMPARISON_ERROR = 1e-6;
-    const std::set<std::string> stop_words_;
-    std::map<std::string_view , std::map<int, double>> word_to_document_frequency_;
+    const StopWordFilter stop_words_;
+    // Термы не удаляются из словаря вместе с документами, их списки вхождений просто пустеют.
+    TermTable terms_;
     std::map<int, std::map<std::string_view , double>> document_to_word_frequency_;
     std::map<int, DocumentData> documents_;
+    // Списки вхождений, накопители релевантности и маски статусов адресуют документы слотами attributes_,
+    // в id документа слот переводится только при выдаче результата. DocumentMatcher тоже получает слот.
+    DocumentAttributes attributes_;
     std::set<int> document_ids_;
+    const CorpusStatistics* corpus_statistics_ = nullptr;
+    TermWeightPrecision term_weight_precision_ = TermWeightPrecision::DOUBLE;
+    mutable AdaptivePolicySelector policy_selector_;
+    std::optional<TieredStorageOptions> tiered_storage_options_;
+    // Файл холодных списков. Копии сервера делят его с оригиналом.
+    std::shared_ptr<const MappedFile> cold_postings_;
+    size_t tiered_rebalance_count_ = 0;
+
+    static StopWordFilter MakeStopWordFilter(const std::set<std::string>& stop_words);
 
     [[nodiscard]] bool IsStopWord(const std::string& word) const;
 
     static void IsValidWord(const std::string& word);
 
-    [[nodiscard]] std::vector<std::string> SplitIntoWordsNoStop(const std::string& text) const;
+    [[nodiscard]] std::vector<std::string> SplitIntoWordsNoStop(std::string_view text) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    void CheckNewDocumentId(int document_id) const;
+    void CheckExistingDocumentId(int document_id) const;
+
+    void InsertDocument(int document_id, std::map<std::string, double>&& word_frequencies,
+                        DocumentStatus status, int rating);
+
+    // Сливает прежние и новые частоты слов документа и правит только различающиеся.
+    void ReplaceWordFrequencies(int document_id, std::map<std::string, double>&& word_frequencies);
+
     struct QueryWord {
         std::string data;
+        uint64_t hash;
         bool is_minus;
         bool is_stop;
     };
 
     [[nodiscard]] QueryWord ParseQueryWord(std::string text) const;
 
+    // Слово запроса -> его HashTerm. Хеш считается один раз при разборе и используется
+    // и для проверки стоп-слова, и для поиска в словаре.
     struct Query {
-        std::set<std::string> plus_words;
-        std::set<std::string> minus_words;
+        std::map<std::string, uint64_t> plus_words;
+        std::map<std::string, uint64_t> minus_words;
     };
 
     [[nodiscard]] Query ParseQuery(std::string_view text) const;
 
-    [[nodiscard]] double ComputeWordInverseDocumentFreq(const std::string& word) const;
+    [[nodiscard]] double ComputeWordInverseDocumentFreq(std::string_view word, const TermHandle& term) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+    [[nodiscard]] matched_word_with_status MatchQuery(const Query& query, int document_id) const;
+    // Есть ли слово в документе со слотом slot, по списку вхождений слова: у длинных списков это проверка бита.
+    [[nodiscard]] bool ContainsWord(std::string_view word, uint64_t hash, int slot) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, DocumentPredicate document_predicate) const;
+    // Частота и IDF слов запроса. visited - пройденные вхождения найденных термов в порядке слов запроса.
+    [[nodiscard]] std::vector<TermProfile> ProfileQueryTerms(const Query& query, const std::vector<size_t>& plus_visited,
+                                                             const std::vector<size_t>& minus_visited) const;
+
+    template <typename DocumentMatcher>
+    ProfiledSearchResult FindTopDocumentsProfiledImpl(std::string_view raw_query, DocumentMatcher document_matcher, QueryMode mode) const;
+
+    template <typename ExecutionPolicy, typename DocumentMatcher>
+    std::vector<Document> FindTopDocumentsImpl(const ExecutionPolicy& policy, std::string_view raw_query, DocumentMatcher document_matcher, QueryMode mode) const;
+
+    template <typename ExecutionPolicy, typename DocumentMatcher>
+    BudgetedSearchResult FindTopDocumentsBudgetedImpl(const ExecutionPolicy& policy, std::string_view raw_query,
+                                                      std::chrono::steady_clock::time_point deadline,
+                                                      DocumentMatcher document_matcher, QueryMode mode) const;
+
+    struct ScoredTerm {
+        const PostingList* postings;
+        double inverse_document_freq;
+    };
+
+    // Плотный массив релевантности по слотам документов и маска слотов, получивших вклад. Переиспользуется
+    // запросами одного потока: после запроса в нём снова только нули. Память не возвращается: каждый поток,
+    // считавший запрос, в том числе рабочий поток TBB, до своего завершения держит 8 байт и бит на слот.
+    // Поток, который ждёт параллельный алгоритм, пока его накопитель занят, должен делать это внутри
+    // tbb::this_task_arena::isolate, иначе он может взять чужую задачу, и та начнёт считать в тот же накопитель.
+    struct ScoringScratch {
+        std::vector<double> relevance;
+        DocumentBitmap candidates;
+    };
+
+    static ScoringScratch& GetScoringScratch(size_t document_capacity);
+
+    // Накопители группы пакетных запросов: релевантность документа id для запроса в слоте k лежит
+    // в relevance[k * document_capacity + id]. Как и ScoringScratch, после группы снова содержит только нули,
+    // но принадлежит одному вызову FindTopDocumentsBatch: по накопителю на поток, освобождаются в конце пакета.
+    struct BatchScratch {
+        std::vector<double> relevance;
+        std::vector<DocumentBitmap> candidates;
+        std::vector<DocumentBitmap> excluded;
+        // Найденные документы текущего запроса группы до сортировки и обрезки.
+        std::vector<Document> matched_documents;
+    };
+
+    // Списки вхождений группы читаются кусками такого размера: кусок остаётся в L1, пока его вклад
+    // раскладывается по накопителям всех запросов группы.
+    static constexpr size_t BATCH_CHUNK_SIZE = 1024;
+
+    static void PrepareBatchScratch(BatchScratch& scratch, size_t document_capacity, size_t slot_count);
+
+    // Наибольшее число запросов в группе: не больше MAX_BATCH_GROUP_SIZE и столько, чтобы накопители
+    // группы занимали не больше BATCH_SCRATCH_BYTES.
+    static size_t GetBatchGroupSize(size_t document_capacity);
+
+    // Найденное слово запроса пакета. Словарь опрашивается один раз на слово запроса, как и при
+    // выполнении запроса по отдельности, поэтому счётчики обращений к термам не удваиваются.
+    struct BatchQueryTerm {
+        std::string_view word;
+        TermHandle term;
+    };
+
+    // Найденные слова запроса пакета в лексикографическом порядке, как в Query.
+    struct BatchQuery {
+        std::vector<BatchQueryTerm> plus_terms;
+        std::vector<BatchQueryTerm> minus_terms;
+    };
+
+    // Выполняет запрос пакета, ни с кем не сгруппированный, так же как FindTopDocuments.
+    // Возвращает число прочитанных вхождений.
+    size_t ScoreBatchQuery(const BatchQuery& query, const DocumentFilter& filter, const DocumentBitmap& status_mask,
+                           std::vector<Document>& result) const;
+
+    // Выполняет группу запросов queries[group[k]], результат k-го кладёт в results[group[k]].
+    // Возвращает число прочитанных вхождений.
+    size_t ScoreBatchGroup(const std::vector<BatchQuery>& queries, const std::vector<size_t>& group, const DocumentFilter& filter,
+                           const DocumentBitmap& status_mask, BatchScratch& scratch,
+                           std::vector<std::vector<Document>>& results) const;
+
+    struct ResolvedQuery {
+        std::vector<ScoredTerm> plus_terms;
+        std::vector<const PostingList*> minus_postings;
+    };
+
+    [[nodiscard]] ResolvedQuery ResolveQuery(const Query& query) const;
+
+    // Прибавляет вклад терма к релевантности документов из [begin_id, end_id) и отмечает их кандидатами.
+    static void AccumulateTerm(const ScoredTerm& term, int begin_id, int end_id, ScoringScratch& scratch);
+    // То же для вхождений терма с позициями [begin, end).
+    static void AccumulatePostings(const ScoredTerm& term, size_t begin, size_t end, ScoringScratch& scratch);
+    // Снимает с кандидатов документы, содержащие минус-слова.
+    static void ExcludeMinusPostings(const std::vector<const PostingList*>& minus_postings, int begin_id, int end_id,
+                                     ScoringScratch& scratch);
+
+    template <typename DocumentMatcher>
+    void CollectCandidates(int begin_id, int end_id, ScoringScratch& scratch,
+                           DocumentMatcher document_matcher, std::vector<Document>& matched_documents) const;
+
+    template <typename DocumentMatcher>
+    void ScoreDocumentRange(const ResolvedQuery& resolved_query, int begin_id, int end_id, ScoringScratch& scratch,
+                            DocumentMatcher document_matcher, std::vector<Document>& matched_documents) const;
+
+    template <typename DocumentMatcher>
+    std::vector<Document> FindAllDocuments(const ResolvedQuery& resolved_query, DocumentMatcher document_matcher) const;
+
+    template <typename DocumentMatcher>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, const ResolvedQuery& resolved_query,
+                                           DocumentMatcher document_matcher) const;
+
+    // Размер диапазона id для параллельного подсчёта, кратный 64.
+    static int GetParallelRangeSize(int document_capacity);
+
+    template <typename DocumentMatcher>
+    std::vector<Document> FindAllDocumentsByTerms(const std::execution::parallel_policy& policy, const ResolvedQuery& resolved_query,
+                                                  DocumentMatcher document_matcher) const;
+
+    struct ConjunctiveQuery {
+        std::vector<ScoredTerm> plus_terms;
+        std::vector<size_t> plus_terms_by_size;
+        std::vector<const PostingList*> minus_postings;
+    };
+
+    [[nodiscard]] bool PrepareConjunctiveQuery(const Query& query, ConjunctiveQuery& conjunctive_query) const;
+
+    // Разобранный запрос с найденными термами, оценкой стоимости и выбранным способом выполнения.
+    struct QueryPlan {
+        QueryMode mode = QueryMode::ANY;
+        QueryExecution execution = QueryExecution::SEQUENTIAL;
+        QueryCostEstimate cost;
+        ResolvedQuery resolved_query;
+        ConjunctiveQuery conjunctive_query;
+        // false, если в режиме ALL какого-то плюс-слова нет ни в одном документе.
+        bool has_matches = true;
+    };
+
+    [[nodiscard]] QueryPlan PlanQuery(const Query& query, QueryMode mode) const;
+
+    template <typename DocumentMatcher>
+    std::vector<Document> ExecuteQueryPlan(const QueryPlan& plan, DocumentMatcher document_matcher) const;
+
+    // Счётчики пересечения для профилирования: сколько вхождений каждого списка пройдено
+    // и сколько документов содержат все плюс-слова и сколько из них снято минус-словами.
+    struct IntersectionStats {
+        std::vector<size_t> plus_visited;
+        std::vector<size_t> minus_visited;
+        size_t candidate_count = 0;
+        size_t excluded_by_minus = 0;
+    };
+
+    template <typename DocumentMatcher>
+    void IntersectPostings(const ConjunctiveQuery& conjunctive_query, size_t begin, size_t end,
+                           DocumentMatcher document_matcher, std::vector<Document>& matched_documents,
+                           IntersectionStats* stats = nullptr) const;
+
+    template <typename DocumentMatcher>
+    std::vector<Document> FindAllDocumentsConjunctive(const ConjunctiveQuery& conjunctive_query, DocumentMatcher document_matcher) const;
+
+    template <typename DocumentMatcher>
+    std::vector<Document> FindAllDocumentsConjunctive(const std::execution::parallel_policy& policy, const ConjunctiveQuery& conjunctive_query,
+                                                      DocumentMatcher document_matcher) const;
+
+    // Срок запроса, общий для всех потоков, которые его выполняют. Часы проверяются между кусками работы,
+    // первый поток, заметивший истечение срока, останавливает остальных.
+    class DeadlineSignal {
+    public:
+        explicit DeadlineSignal(std::chrono::steady_clock::time_point deadline)
+                : deadline_(deadline) {
+        }
+
+        [[nodiscard]] bool IsExpired() {
+            if (expired_.load(std::memory_order_relaxed)) {
+                return true;
+            }
+            if (std::chrono::steady_clock::now() < deadline_) {
+                return false;
+            }
+            expired_.store(true, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        std::chrono::steady_clock::time_point deadline_;
+        std::atomic<bool> expired_ = false;
+    };
+
+    // Между проверками срока проходится столько вхождений: на них уходят единицы микросекунд,
+    // а проверка стоит десятки наносекунд.
+    static constexpr size_t DEADLINE_CHECK_POSTINGS = 4096;
+    // Слова с более короткими списками при параллельном выполнении проходятся вызывающим потоком.
+    static constexpr size_t DEADLINE_PARALLEL_TERM_POSTINGS = 16 * DEADLINE_CHECK_POSTINGS;
+
+    // AccumulatePostings кусками по DEADLINE_CHECK_POSTINGS с проверкой срока перед каждым.
+    // Возвращает число пройденных вхождений.
+    static size_t AccumulatePostingsWithin(const ScoredTerm& term, size_t begin, size_t end, ScoringScratch& scratch,
+                                           DeadlineSignal& signal);
+
+    // Плюс-слова по убыванию IDF.
+    [[nodiscard]] static std::vector<size_t> OrderByImpact(const std::vector<ScoredTerm>& plus_terms);
+
+    // Варианты FindAllDocuments со сроком. postings_done - сколько вхождений плюс-слов успели пройти.
+    template <typename DocumentMatcher>
+    std::vector<Document> FindAllDocumentsWithin(const ResolvedQuery& resolved_query, DocumentMatcher document_matcher,
+                                                 DeadlineSignal& signal, size_t& postings_done) const;
+
+    // Слова проходятся по очереди, длинный список делится между потоками по диапазонам id, поэтому
+    // к моменту остановки все документы успевают получить вклад самых весомых слов.
+    template <typename DocumentMatcher>
+    std::vector<Document> FindAllDocumentsWithin(const std::execution::parallel_policy& policy, const ResolvedQuery& resolved_query,
+                                                 DocumentMatcher document_matcher, DeadlineSignal& signal, size_t& postings_done) const;
+
+    template <typename DocumentMatcher>
+    std::vector<Document> FindAllDocumentsConjunctiveWithin(const ConjunctiveQuery& conjunctive_query, DocumentMatcher document_matcher,
+                                                            DeadlineSignal& signal, size_t& postings_done) const;
+
+    template <typename DocumentMatcher>
+    std::vector<Document> FindAllDocumentsConjunctiveWithin(const std::execution::parallel_policy& policy,
+                                                            const ConjunctiveQuery& conjunctive_query, DocumentMatcher document_matcher,
+                                                            DeadlineSignal& signal, size_t& postings_done) const;
 
 };
 
 
 
 template <typename DocumentPredicate>
-[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    Query query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(query, document_predicate);
+[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, QueryMode mode) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, mode);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate, QueryMode mode) const {
+    return FindTopDocumentsImpl(
+            policy,
+            raw_query,
+            [this, &document_predicate](int slot) {
+                return document_predicate(attributes_.GetDocumentId(slot), attributes_.GetStatus(slot), attributes_.GetRating(slot));
+            },
+            mode);
+}
+
+template <typename ExecutionPolicy>
+[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, QueryMode mode) const{
+    return FindTopDocuments(policy, raw_query, DocumentFilter(status), mode);
+}
+
+template <typename ExecutionPolicy>
+[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, const DocumentFilter& filter, QueryMode mode) const{
+    DocumentBitmap status_mask_buffer;
+    const DocumentBitmap& status_mask = attributes_.BuildStatusMask(filter, status_mask_buffer);
+    return FindTopDocumentsImpl(
+            policy,
+            raw_query,
+            [this, &status_mask, &filter](int slot) {
+                return status_mask.Test(slot) && filter.AcceptsRating(attributes_.GetRating(slot));
+            },
+            mode);
+}
+
+template<typename ExecutionPolicy>
+[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view  raw_query) const{
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template<typename ExecutionPolicy>
+[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view  raw_query, QueryMode mode) const{
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL, mode);
+}
+
+template <typename ExecutionPolicy>
+BudgetedSearchResult SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                                    std::chrono::steady_clock::time_point deadline,
+                                                    DocumentStatus status, QueryMode mode) const {
+    return FindTopDocuments(policy, raw_query, deadline, DocumentFilter(status), mode);
+}
+
+template <typename ExecutionPolicy>
+BudgetedSearchResult SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                                    std::chrono::steady_clock::time_point deadline,
+                                                    const DocumentFilter& filter, QueryMode mode) const {
+    DocumentBitmap status_mask_buffer;
+    const DocumentBitmap& status_mask = attributes_.BuildStatusMask(filter, status_mask_buffer);
+    return FindTopDocumentsBudgetedImpl(
+            policy,
+            raw_query,
+            deadline,
+            [this, &status_mask, &filter](int slot) {
+                return status_mask.Test(slot) && filter.AcceptsRating(attributes_.GetRating(slot));
+            },
+            mode);
+}
+
+template <typename ExecutionPolicy>
+BudgetedSearchResult SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                                    std::chrono::steady_clock::time_point deadline, QueryMode mode) const {
+    return FindTopDocuments(policy, raw_query, deadline, DocumentStatus::ACTUAL, mode);
+}
+
+template <typename ExecutionPolicy, typename DocumentMatcher>
+std::vector<Document> SearchServer::FindTopDocumentsImpl(const ExecutionPolicy&, const std::string_view raw_query, DocumentMatcher document_matcher, QueryMode mode) const {
+    const auto start = std::chrono::steady_clock::now();
+    QueryPlan plan = PlanQuery(ParseQuery(raw_query), mode);
+    if constexpr(std::is_same_v<ExecutionPolicy, AdaptiveExecutionPolicy>){
+        plan.execution = policy_selector_.Choose(plan.cost);
+    } else if constexpr(!std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>){
+        plan.execution = QueryExecution::DOCUMENT_RANGE_PARALLEL;
+    }
+
+    std::vector<Document> matched_documents = ExecuteQueryPlan(plan, document_matcher);
+
+    if (plan.execution == QueryExecution::SEQUENTIAL) {
+        std::sort(matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
+    } else {
+        std::sort(std::execution::par, matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
+    }
 
-    std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < DOUBLE_COMPARISON_ERROR) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
-        }
-    });
     if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
         matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
     }
 
+    if constexpr(std::is_same_v<ExecutionPolicy, AdaptiveExecutionPolicy>){
+        policy_selector_.Record(plan.execution, plan.cost, std::chrono::steady_clock::now() - start);
+    }
     return matched_documents;
 }
 
-template <typename ExecutionPolicy, typename DocumentPredicate>
-[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    if constexpr(std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>){
-        return FindTopDocuments(raw_query, document_predicate);
+// Выбор adaptive_execution не записывается в статистику политики: задержка запроса со сроком
+// ограничена сроком, а не стоимостью.
+template <typename ExecutionPolicy, typename DocumentMatcher>
+BudgetedSearchResult SearchServer::FindTopDocumentsBudgetedImpl(const ExecutionPolicy&, std::string_view raw_query,
+                                                                std::chrono::steady_clock::time_point deadline,
+                                                                DocumentMatcher document_matcher, QueryMode mode) const {
+    QueryPlan plan = PlanQuery(ParseQuery(raw_query), mode);
+    if constexpr(std::is_same_v<ExecutionPolicy, AdaptiveExecutionPolicy>){
+        plan.execution = policy_selector_.Choose(plan.cost);
+    } else if constexpr(!std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>){
+        plan.execution = QueryExecution::DOCUMENT_RANGE_PARALLEL;
+    }
+    const bool parallel = plan.execution != QueryExecution::SEQUENTIAL;
+
+    BudgetedSearchResult result;
+    if (!plan.has_matches) {
+        return result;
+    }
+    DeadlineSignal signal(deadline);
+    size_t postings_done = 0;
+    size_t postings_total = 0;
+    std::vector<Document>& matched_documents = result.documents;
+    if (mode == QueryMode::ALL) {
+        const ConjunctiveQuery& conjunctive_query = plan.conjunctive_query;
+        postings_total = conjunctive_query.plus_terms[conjunctive_query.plus_terms_by_size[0]].postings->size();
+        matched_documents = parallel
+                ? FindAllDocumentsConjunctiveWithin(std::execution::par, conjunctive_query, document_matcher, signal, postings_done)
+                : FindAllDocumentsConjunctiveWithin(conjunctive_query, document_matcher, signal, postings_done);
     } else {
-        Query query = ParseQuery(raw_query);
+        for (const ScoredTerm& term : plan.resolved_query.plus_terms) {
+            postings_total += term.postings->size();
+        }
+        matched_documents = parallel
+                ? FindAllDocumentsWithin(std::execution::par, plan.resolved_query, document_matcher, signal, postings_done)
+                : FindAllDocumentsWithin(plan.resolved_query, document_matcher, signal, postings_done);
+    }
+    result.partial = postings_done < postings_total;
+    result.completed_fraction = postings_total == 0 ? 1.0 : static_cast<double>(postings_done) / static_cast<double>(postings_total);
+
+    // Полная сортировка всех найденных документов сама может съесть бюджет, нужны только первые.
+    const size_t result_count = std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(matched_documents.begin(), matched_documents.begin() + result_count, matched_documents.end(), IsMoreRelevant);
+    matched_documents.resize(result_count);
+    return result;
+}
 
-        auto matched_documents = FindAllDocuments(static_cast<const std::execution::parallel_policy>(policy), query, document_predicate);
+template <typename DocumentPredicate>
+ProfiledSearchResult SearchServer::FindTopDocumentsProfiled(std::string_view raw_query, DocumentPredicate document_predicate, QueryMode mode) const {
+    return FindTopDocumentsProfiledImpl(
+            raw_query,
+            [this, &document_predicate](int slot) {
+                return document_predicate(attributes_.GetDocumentId(slot), attributes_.GetStatus(slot), attributes_.GetRating(slot));
+            },
+            mode);
+}
 
-        std::sort(policy, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < DOUBLE_COMPARISON_ERROR) {
-                return lhs.rating > rhs.rating;
-            } else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
+template <typename DocumentMatcher>
+ProfiledSearchResult SearchServer::FindTopDocumentsProfiledImpl(std::string_view raw_query, DocumentMatcher document_matcher, QueryMode mode) const {
+    using Clock = std::chrono::steady_clock;
+    ProfiledSearchResult result;
+    QueryProfile& profile = result.profile;
+    QueryStageTimings& timings = profile.timings;
+    std::vector<Document>& matched_documents = result.documents;
+    profile.raw_query = std::string(raw_query);
+
+    const auto start = Clock::now();
+    auto stage_start = start;
+    const auto finish_stage = [&stage_start](std::chrono::nanoseconds& stage) {
+        const auto now = Clock::now();
+        stage = now - stage_start;
+        stage_start = now;
+    };
 
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    const Query query = ParseQuery(raw_query);
+    finish_stage(timings.parse);
+    const QueryPlan plan = PlanQuery(query, mode);
+    finish_stage(timings.term_lookup);
+
+    size_t matcher_calls = 0;
+    const auto counting_matcher = [&matcher_calls, &document_matcher](int document_id) {
+        ++matcher_calls;
+        return document_matcher(document_id);
+    };
+    std::vector<size_t> plus_visited;
+    std::vector<size_t> minus_visited;
+    if (mode == QueryMode::ALL) {
+        if (plan.has_matches) {
+            const ConjunctiveQuery& conjunctive_query = plan.conjunctive_query;
+            const size_t rarest_size = conjunctive_query.plus_terms[conjunctive_query.plus_terms_by_size[0]].postings->size();
+            IntersectionStats stats;
+            IntersectPostings(conjunctive_query, 0, rarest_size, counting_matcher, matched_documents, &stats);
+            profile.candidate_count = stats.candidate_count;
+            profile.excluded_by_minus = stats.excluded_by_minus;
+            plus_visited = std::move(stats.plus_visited);
+            minus_visited = std::move(stats.minus_visited);
+        }
+        finish_stage(timings.scoring);
+    } else {
+        const int capacity = static_cast<int>(attributes_.GetCapacity());
+        ScoringScratch& scratch = GetScoringScratch(capacity);
+        for (const ScoredTerm& term : plan.resolved_query.plus_terms) {
+            AccumulateTerm(term, 0, capacity, scratch);
+            plus_visited.push_back(term.postings->size());
         }
+        profile.candidate_count = scratch.candidates.Count(0, capacity);
+        finish_stage(timings.scoring);
 
-        return matched_documents;
-    }
+        ExcludeMinusPostings(plan.resolved_query.minus_postings, 0, capacity, scratch);
+        for (const PostingList* postings : plan.resolved_query.minus_postings) {
+            minus_visited.push_back(postings->size());
+        }
+        profile.excluded_by_minus = profile.candidate_count - scratch.candidates.Count(0, capacity);
+        finish_stage(timings.minus_exclusion);
 
-}
+        CollectCandidates(0, capacity, scratch, counting_matcher, matched_documents);
+        finish_stage(timings.filtering);
+    }
+    profile.rejected_by_filter = matcher_calls - matched_documents.size();
+    profile.matched_count = matched_documents.size();
 
-template <typename ExecutionPolicy>
-[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status) const{
-        return FindTopDocuments(
-                policy,
-                raw_query,
-                [status](int document_id, DocumentStatus document_status, int rating) {
-                    return document_status == status;
-                });
+    std::sort(matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    finish_stage(timings.sorting);
+    timings.total = stage_start - start;
+
+    profile.result_count = matched_documents.size();
+    profile.cost = plan.cost;
+    profile.suggested_execution = policy_selector_.Choose(plan.cost);
+    profile.terms = ProfileQueryTerms(query, plus_visited, minus_visited);
+    return result;
 }
 
-template<typename ExecutionPolicy>
-[[nodiscard]] std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view  raw_query) const{
-    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+template <typename DocumentMatcher>
+std::vector<Document> SearchServer::ExecuteQueryPlan(const QueryPlan& plan, DocumentMatcher document_matcher) const {
+    if (!plan.has_matches) {
+        return {};
+    }
+    if (plan.mode == QueryMode::ALL) {
+        return plan.execution == QueryExecution::SEQUENTIAL
+               ? FindAllDocumentsConjunctive(plan.conjunctive_query, document_matcher)
+               : FindAllDocumentsConjunctive(std::execution::par, plan.conjunctive_query, document_matcher);
+    }
+    switch (plan.execution) {
+        case QueryExecution::SEQUENTIAL:
+            return FindAllDocuments(plan.resolved_query, document_matcher);
+        case QueryExecution::TERM_PARALLEL:
+            return FindAllDocumentsByTerms(std::execution::par, plan.resolved_query, document_matcher);
+        default:
+            return FindAllDocuments(std::execution::par, plan.resolved_query, document_matcher);
+    }
 }
 
 template<typename ExecutionPolicy>
@@ -184,15 +793,17 @@ void SearchServer::RemoveDocument(const ExecutionPolicy& policy, int document_id
         }
         std::vector<std::string_view> words_in_document_with_document_id(documents_.at(document_id).words_.begin(),
                                                                documents_.at(document_id).words_.end());
+        const int slot = attributes_.FindSlot(document_id);
 
         for_each(policy, words_in_document_with_document_id.begin(),
                  words_in_document_with_document_id.end(),
                  [&](const std::string_view word){
-                     word_to_document_frequency_.at(word).erase(document_id);
+                     terms_.FindPostings(word)->Erase(slot);
                  });
 
         document_to_word_frequency_.erase(document_id);
         documents_.erase(document_id);
+        attributes_.Remove(document_id);
         document_ids_.erase(document_id);
     }
 }
@@ -202,21 +813,28 @@ template<typename ExecutionPolicy>
     if constexpr(std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>){
         return MatchDocument(raw_query, document_id);
     } else {
+        PERF_SCOPE("MatchDocument(par)");
         Query query = ParseQuery(raw_query);
         const auto& words_in_document = documents_.at(document_id).words_;
+        const int slot = attributes_.FindSlot(document_id);
 
         auto word_checker = [&words_in_document](const std::string_view & word){
             return words_in_document.count(word);
         };
+        auto minus_word_checker = [this, slot](const std::pair<const std::string, uint64_t>& minus_word){
+            return ContainsWord(minus_word.first, minus_word.second, slot);
+        };
 
-        std::vector <std::string_view> minus_word(query.minus_words.begin(), query.minus_words.end());
-
-        if(any_of(policy, minus_word.begin(), minus_word.end(), word_checker)){
-            return {std::vector <std::string_view> {}, documents_.at(document_id).status};
+        if(any_of(policy, query.minus_words.begin(), query.minus_words.end(), minus_word_checker)){
+            return {std::vector <std::string_view> {}, attributes_.GetStatus(slot)};
         }
 
         std::vector <std::string_view> pre_matched_words(query.plus_words.size());
-        std::vector <std::string_view> plus_words(query.plus_words.begin(), query.plus_words.end());
+        std::vector <std::string_view> plus_words;
+        plus_words.reserve(query.plus_words.size());
+        for (const auto& [word, hash] : query.plus_words) {
+            plus_words.push_back(word);
+        }
         auto It_end = copy_if(policy, plus_words.begin(), plus_words.end(), pre_matched_words.begin(), word_checker);
         pre_matched_words.erase(It_end, pre_matched_words.end());
 
@@ -231,72 +849,360 @@ template<typename ExecutionPolicy>
                  }
         );
 
-        return {matched_words, documents_.at(document_id).status};
+        return {matched_words, attributes_.GetStatus(slot)};
     }
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (const std::string& word : query.plus_words) {
-        if (word_to_document_frequency_.count(word) == 0) {
+template <typename DocumentMatcher>
+void SearchServer::CollectCandidates(int begin_id, int end_id, ScoringScratch& scratch,
+                                     DocumentMatcher document_matcher, std::vector<Document>& matched_documents) const {
+    double* relevance = scratch.relevance.data();
+    scratch.candidates.ExtractEach(begin_id, end_id, [&](int slot) {
+        const double document_relevance = relevance[slot];
+        relevance[slot] = 0.0;
+        if (document_matcher(slot)) {
+            matched_documents.emplace_back(attributes_.GetDocumentId(slot), document_relevance, attributes_.GetRating(slot));
+        }
+    });
+}
+
+template <typename DocumentMatcher>
+void SearchServer::ScoreDocumentRange(const ResolvedQuery& resolved_query, int begin_id, int end_id, ScoringScratch& scratch,
+                                      DocumentMatcher document_matcher, std::vector<Document>& matched_documents) const {
+    for (const ScoredTerm& term : resolved_query.plus_terms) {
+        AccumulateTerm(term, begin_id, end_id, scratch);
+    }
+    ExcludeMinusPostings(resolved_query.minus_postings, begin_id, end_id, scratch);
+    CollectCandidates(begin_id, end_id, scratch, document_matcher, matched_documents);
+}
+
+template <typename DocumentMatcher>
+std::vector<Document> SearchServer::FindAllDocuments(const ResolvedQuery& resolved_query, DocumentMatcher document_matcher) const {
+    PERF_SCOPE("FindAllDocuments(seq)");
+    const int capacity = static_cast<int>(attributes_.GetCapacity());
+    std::vector<Document> matched_documents;
+    ScoreDocumentRange(resolved_query, 0, capacity, GetScoringScratch(capacity), document_matcher, matched_documents);
+    return matched_documents;
+}
+
+// Диапазон id делится на куски, кратные 64, чтобы потоки писали в разные слова битовой маски кандидатов
+// и в разные ячейки общего массива релевантности.
+template <typename DocumentMatcher>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& policy, const ResolvedQuery& resolved_query,
+                                                     DocumentMatcher document_matcher) const {
+    PERF_SCOPE("FindAllDocuments(par)");
+    const int capacity = static_cast<int>(attributes_.GetCapacity());
+    ScoringScratch& scratch = GetScoringScratch(capacity);
+
+    const int range_size = GetParallelRangeSize(capacity);
+    std::vector<std::vector<Document>> range_results((capacity + range_size - 1) / range_size);
+    std::vector<int> range_indexes(range_results.size());
+    std::iota(range_indexes.begin(), range_indexes.end(), 0);
+
+    tbb::this_task_arena::isolate([&] {
+        std::for_each(policy, range_indexes.begin(), range_indexes.end(),
+                      [&](int range_index) {
+                          PERF_SCOPE("FindAllDocuments(par) range");
+                          const int begin_id = range_index * range_size;
+                          const int end_id = std::min(begin_id + range_size, capacity);
+                          ScoreDocumentRange(resolved_query, begin_id, end_id, scratch, document_matcher, range_results[range_index]);
+                      });
+    });
+
+    std::vector<Document> matched_documents;
+    for (auto& range_result : range_results) {
+        matched_documents.insert(matched_documents.end(), range_result.begin(), range_result.end());
+    }
+    return matched_documents;
+}
+
+// Плюс-слова делятся на группы с близкой суммарной длиной списков. Каждая группа считается в накопителе
+// своего потока, частичные суммы складываются в накопитель вызывающего потока по порядку групп.
+// Из-за другой расстановки скобок в суммах релевантность может отличаться от последовательной
+// в последних битах, намного меньше DOUBLE_COMPARISON_ERROR.
+template <typename DocumentMatcher>
+std::vector<Document> SearchServer::FindAllDocumentsByTerms(const std::execution::parallel_policy& policy, const ResolvedQuery& resolved_query,
+                                                            DocumentMatcher document_matcher) const {
+    PERF_SCOPE("FindAllDocuments(par terms)");
+    const auto& plus_terms = resolved_query.plus_terms;
+    const int capacity = static_cast<int>(attributes_.GetCapacity());
+    const size_t group_count = std::min<size_t>(plus_terms.size(), std::max(1u, std::thread::hardware_concurrency()));
+
+    std::vector<size_t> by_size(plus_terms.size());
+    std::iota(by_size.begin(), by_size.end(), 0);
+    std::sort(by_size.begin(), by_size.end(), [&plus_terms](size_t lhs, size_t rhs) {
+        return plus_terms[lhs].postings->size() > plus_terms[rhs].postings->size();
+    });
+    std::vector<std::vector<size_t>> groups(group_count);
+    std::vector<size_t> group_postings(group_count, 0);
+    for (const size_t term_index : by_size) {
+        const size_t group = std::min_element(group_postings.begin(), group_postings.end()) - group_postings.begin();
+        groups[group].push_back(term_index);
+        group_postings[group] += plus_terms[term_index].postings->size();
+    }
+
+    std::vector<std::vector<std::pair<int, double>>> partial_sums(group_count);
+    std::vector<size_t> group_indexes(group_count);
+    std::iota(group_indexes.begin(), group_indexes.end(), 0);
+    std::for_each(policy, group_indexes.begin(), group_indexes.end(),
+                  [&](size_t group) {
+                      PERF_SCOPE("FindAllDocuments(par terms) group");
+                      std::sort(groups[group].begin(), groups[group].end());
+                      ScoringScratch& scratch = GetScoringScratch(capacity);
+                      for (const size_t term_index : groups[group]) {
+                          AccumulateTerm(plus_terms[term_index], 0, capacity, scratch);
+                      }
+                      double* relevance = scratch.relevance.data();
+                      scratch.candidates.ExtractEach(0, capacity, [&](int document_id) {
+                          partial_sums[group].emplace_back(document_id, relevance[document_id]);
+                          relevance[document_id] = 0.0;
+                      });
+                  });
+
+    ScoringScratch& scratch = GetScoringScratch(capacity);
+    for (const auto& group_sums : partial_sums) {
+        for (const auto& [document_id, partial_relevance] : group_sums) {
+            scratch.relevance[document_id] += partial_relevance;
+            scratch.candidates.Set(document_id);
+        }
+    }
+    ExcludeMinusPostings(resolved_query.minus_postings, 0, capacity, scratch);
+    std::vector<Document> matched_documents;
+    CollectCandidates(0, capacity, scratch, document_matcher, matched_documents);
+    return matched_documents;
+}
+
+template <typename DocumentMatcher>
+void SearchServer::IntersectPostings(const ConjunctiveQuery& conjunctive_query, size_t begin, size_t end,
+                                     DocumentMatcher document_matcher, std::vector<Document>& matched_documents,
+                                     IntersectionStats* stats) const {
+    const auto& plus_terms = conjunctive_query.plus_terms;
+    const auto& by_size = conjunctive_query.plus_terms_by_size;
+    const PostingList& rarest = *plus_terms[by_size[0]].postings;
+
+    std::vector<size_t> plus_positions(plus_terms.size(), 0);
+    std::vector<size_t> minus_positions(conjunctive_query.minus_postings.size(), 0);
+
+    size_t scanned_end = end;
+    for (size_t i = begin; i < end; ++i) {
+        const int slot = rarest.DocumentIdAt(i);
+        plus_positions[by_size[0]] = i;
+
+        bool contains_all = true;
+        bool exhausted = false;
+        for (size_t k = 1; k < by_size.size(); ++k) {
+            const PostingList& postings = *plus_terms[by_size[k]].postings;
+            size_t& position = plus_positions[by_size[k]];
+            position = postings.Gallop(position, slot);
+            if (position == postings.size()) {
+                exhausted = true;
+                break;
+            }
+            if (postings.DocumentIdAt(position) != slot) {
+                contains_all = false;
+                break;
+            }
+        }
+        if (exhausted) {
+            scanned_end = i + 1;
+            break;
+        }
+        if (!contains_all) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_frequency_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        if (stats) {
+            ++stats->candidate_count;
+        }
+
+        bool has_minus_word = false;
+        for (size_t k = 0; k < minus_positions.size(); ++k) {
+            const PostingList& postings = *conjunctive_query.minus_postings[k];
+            if (const RoaringBitmap* bitmap = postings.GetBitmap()) {
+                if (bitmap->Contains(slot)) {
+                    has_minus_word = true;
+                    break;
+                }
+                continue;
+            }
+            minus_positions[k] = postings.Gallop(minus_positions[k], slot);
+            if (minus_positions[k] < postings.size() && postings.DocumentIdAt(minus_positions[k]) == slot) {
+                has_minus_word = true;
+                break;
             }
         }
-    }
+        if (has_minus_word) {
+            if (stats) {
+                ++stats->excluded_by_minus;
+            }
+            continue;
+        }
 
-    for (const std::string& word : query.minus_words) {
-        if (word_to_document_frequency_.count(word) == 0) {
+        if (!document_matcher(slot)) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_frequency_.at(word)) {
-            document_to_relevance.erase(document_id);
+
+        double relevance = 0.0;
+        for (size_t k = 0; k < plus_terms.size(); ++k) {
+            relevance += plus_terms[k].postings->TermFreqAt(plus_positions[k]) * plus_terms[k].inverse_document_freq;
         }
+        matched_documents.emplace_back(attributes_.GetDocumentId(slot), relevance, attributes_.GetRating(slot));
     }
 
+    if (stats) {
+        stats->plus_visited = plus_positions;
+        stats->plus_visited[by_size[0]] = scanned_end - begin;
+        stats->minus_visited = minus_positions;
+    }
+}
+
+template <typename DocumentMatcher>
+std::vector<Document> SearchServer::FindAllDocumentsConjunctive(const ConjunctiveQuery& conjunctive_query, DocumentMatcher document_matcher) const {
+    std::vector<Document> matched_documents;
+    const size_t rarest_size = conjunctive_query.plus_terms[conjunctive_query.plus_terms_by_size[0]].postings->size();
+    IntersectPostings(conjunctive_query, 0, rarest_size, document_matcher, matched_documents);
+    return matched_documents;
+}
+
+template <typename DocumentMatcher>
+std::vector<Document> SearchServer::FindAllDocumentsConjunctive(const std::execution::parallel_policy& policy, const ConjunctiveQuery& conjunctive_query,
+                                                                DocumentMatcher document_matcher) const {
+    const size_t rarest_size = conjunctive_query.plus_terms[conjunctive_query.plus_terms_by_size[0]].postings->size();
+
+    constexpr size_t CHUNK_SIZE = 1024;
+    std::vector<std::vector<Document>> chunk_results((rarest_size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    std::vector<size_t> chunk_indexes(chunk_results.size());
+    std::iota(chunk_indexes.begin(), chunk_indexes.end(), 0);
+
+    std::for_each(policy, chunk_indexes.begin(), chunk_indexes.end(),
+                  [&](size_t chunk_index){
+                      const size_t begin = chunk_index * CHUNK_SIZE;
+                      const size_t end = std::min(begin + CHUNK_SIZE, rarest_size);
+                      IntersectPostings(conjunctive_query, begin, end, document_matcher, chunk_results[chunk_index]);
+                  });
+
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.emplace_back(document_id, relevance, documents_.at(document_id).rating);
+    for (auto& chunk_result : chunk_results) {
+        matched_documents.insert(matched_documents.end(), chunk_result.begin(), chunk_result.end());
     }
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(100);
-    vector_string_view minus_words(query.minus_words.begin(), query.minus_words.end());
-    std::vector<std::string> plus_words(query.plus_words.begin(), query.plus_words.end());
-
-    std::for_each(policy, plus_words.begin(), plus_words.end(),
-                    [&](const std::string& word){
-                        if (word_to_document_frequency_.count(word)) {
-                            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                            for (const auto [document_id, term_freq] : word_to_document_frequency_.at(word)) {
-                                const auto& document_data = documents_.at(document_id);
-                                if(std::none_of(policy, minus_words.begin(), minus_words.end(),
-                                                [&document_data](const std::string_view minus_word){
-                                                    return document_data.words_.count(minus_word);
-                                                })){
-                                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                                    }
-                                }
-                            }
-                        }
-                    });
+template <typename DocumentMatcher>
+std::vector<Document> SearchServer::FindAllDocumentsWithin(const ResolvedQuery& resolved_query, DocumentMatcher document_matcher,
+                                                           DeadlineSignal& signal, size_t& postings_done) const {
+    const int capacity = static_cast<int>(attributes_.GetCapacity());
+    ScoringScratch& scratch = GetScoringScratch(capacity);
+    const auto& plus_terms = resolved_query.plus_terms;
+    for (const size_t term_index : OrderByImpact(plus_terms)) {
+        const ScoredTerm& term = plus_terms[term_index];
+        const size_t term_done = AccumulatePostingsWithin(term, 0, term.postings->size(), scratch, signal);
+        postings_done += term_done;
+        if (term_done < term.postings->size()) {
+            break;
+        }
+    }
+    ExcludeMinusPostings(resolved_query.minus_postings, 0, capacity, scratch);
+    std::vector<Document> matched_documents;
+    CollectCandidates(0, capacity, scratch, document_matcher, matched_documents);
+    return matched_documents;
+}
+
+template <typename DocumentMatcher>
+std::vector<Document> SearchServer::FindAllDocumentsWithin(const std::execution::parallel_policy& policy, const ResolvedQuery& resolved_query,
+                                                           DocumentMatcher document_matcher, DeadlineSignal& signal,
+                                                           size_t& postings_done) const {
+    const int capacity = static_cast<int>(attributes_.GetCapacity());
+    ScoringScratch& scratch = GetScoringScratch(capacity);
+    const int range_size = GetParallelRangeSize(capacity);
+    std::vector<int> range_indexes((capacity + range_size - 1) / range_size);
+    std::iota(range_indexes.begin(), range_indexes.end(), 0);
+
+    const auto& plus_terms = resolved_query.plus_terms;
+    for (const size_t term_index : OrderByImpact(plus_terms)) {
+        const ScoredTerm& term = plus_terms[term_index];
+        if (term.postings->size() < DEADLINE_PARALLEL_TERM_POSTINGS) {
+            postings_done += AccumulatePostingsWithin(term, 0, term.postings->size(), scratch, signal);
+        } else {
+            std::atomic<size_t> term_done = 0;
+            tbb::this_task_arena::isolate([&] {
+                std::for_each(policy, range_indexes.begin(), range_indexes.end(),
+                              [&](int range_index) {
+                                  const int begin_id = range_index * range_size;
+                                  const int end_id = std::min(begin_id + range_size, capacity);
+                                  const size_t begin = term.postings->Gallop(0, begin_id);
+                                  const size_t end = term.postings->Gallop(begin, end_id);
+                                  term_done += AccumulatePostingsWithin(term, begin, end, scratch, signal);
+                              });
+            });
+            postings_done += term_done;
+        }
+        if (signal.IsExpired()) {
+            break;
+        }
+    }
+
+    std::vector<std::vector<Document>> range_results(range_indexes.size());
+    tbb::this_task_arena::isolate([&] {
+        std::for_each(policy, range_indexes.begin(), range_indexes.end(),
+                      [&](int range_index) {
+                          const int begin_id = range_index * range_size;
+                          const int end_id = std::min(begin_id + range_size, capacity);
+                          ExcludeMinusPostings(resolved_query.minus_postings, begin_id, end_id, scratch);
+                          CollectCandidates(begin_id, end_id, scratch, document_matcher, range_results[range_index]);
+                      });
+    });
 
     std::vector<Document> matched_documents;
-    std::map<int, double> ordinaryMap_document_to_relevance = move(document_to_relevance.BuildOrdinaryMap());
+    for (auto& range_result : range_results) {
+        matched_documents.insert(matched_documents.end(), range_result.begin(), range_result.end());
+    }
+    return matched_documents;
+}
 
-    for (const auto [document_id, relevance] : ordinaryMap_document_to_relevance) {
-        matched_documents.emplace_back(document_id, relevance, documents_.at(document_id).rating);
+template <typename DocumentMatcher>
+std::vector<Document> SearchServer::FindAllDocumentsConjunctiveWithin(const ConjunctiveQuery& conjunctive_query, DocumentMatcher document_matcher,
+                                                                      DeadlineSignal& signal, size_t& postings_done) const {
+    const size_t rarest_size = conjunctive_query.plus_terms[conjunctive_query.plus_terms_by_size[0]].postings->size();
+
+    constexpr size_t CHUNK_SIZE = 1024;
+    std::vector<Document> matched_documents;
+    for (size_t begin = 0; begin < rarest_size && !signal.IsExpired(); begin += CHUNK_SIZE) {
+        const size_t end = std::min(begin + CHUNK_SIZE, rarest_size);
+        IntersectPostings(conjunctive_query, begin, end, document_matcher, matched_documents);
+        postings_done += end - begin;
     }
     return matched_documents;
 }
 
+// Куски самого редкого списка разбираются потоками в произвольном порядке, поэтому частичный
+// результат собран не обязательно с начала списка.
+template <typename DocumentMatcher>
+std::vector<Document> SearchServer::FindAllDocumentsConjunctiveWithin(const std::execution::parallel_policy& policy,
+                                                                      const ConjunctiveQuery& conjunctive_query, DocumentMatcher document_matcher,
+                                                                      DeadlineSignal& signal, size_t& postings_done) const {
+    const size_t rarest_size = conjunctive_query.plus_terms[conjunctive_query.plus_terms_by_size[0]].postings->size();
+
+    constexpr size_t CHUNK_SIZE = 1024;
+    std::vector<std::vector<Document>> chunk_results((rarest_size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    std::vector<size_t> chunk_indexes(chunk_results.size());
+    std::iota(chunk_indexes.begin(), chunk_indexes.end(), 0);
+    std::atomic<size_t> done = 0;
+
+    std::for_each(policy, chunk_indexes.begin(), chunk_indexes.end(),
+                  [&](size_t chunk_index){
+                      if (signal.IsExpired()) {
+                          return;
+                      }
+                      const size_t begin = chunk_index * CHUNK_SIZE;
+                      const size_t end = std::min(begin + CHUNK_SIZE, rarest_size);
+                      IntersectPostings(conjunctive_query, begin, end, document_matcher, chunk_results[chunk_index]);
+                      done += end - begin;
+                  });
+    postings_done += done;
+
+    std::vector<Document> matched_documents;
+    for (auto& chunk_result : chunk_results) {
+        matched_documents.insert(matched_documents.end(), chunk_result.begin(), chunk_result.end());
+    }
+    return matched_documents;
+}
@@ -0,0 +1,133 @@
+#include "sharded_search_server.h"
+#include "string_processing.h"
+
+using namespace std;
+
+ShardedSearchServer::GlobalStatistics::GlobalStatistics(const vector<SearchServer>& shards)
+        : shards_(shards) {
+}
+
+int ShardedSearchServer::GlobalStatistics::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SearchServer& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+int ShardedSearchServer::GlobalStatistics::GetDocumentFrequency(string_view word) const {
+    int document_frequency = 0;
+    for (const SearchServer& shard : shards_) {
+        document_frequency += shard.GetDocumentFrequency(word);
+    }
+    return document_frequency;
+}
+
+ShardedSearchServer::ShardedSearchServer(const string& stop_words_text, size_t shard_count)
+        : ShardedSearchServer(SplitIntoWords(stop_words_text), shard_count) {
+}
+
+void ShardedSearchServer::ConnectShards() {
+    for (SearchServer& shard : shards_) {
+        shard.SetCorpusStatistics(&statistics_);
+    }
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const string& document, DocumentStatus status,
+                                      const vector<int>& ratings) {
+    if (document_id >= 0 && document_ids_.count(document_id)) {
+        throw invalid_argument("DocumentID "s + to_string(document_id) + " already exists."s);
+    }
+    shards_[GetShardIndex(document_id)].AddDocument(document_id, document, status, ratings);
+    document_ids_.insert(document_id);
+}
+
+void ShardedSearchServer::UpdateDocument(int document_id, const string& document, DocumentStatus status,
+                                         const vector<int>& ratings) {
+    shards_[GetShardIndex(document_id)].UpdateDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::UpdateDocument(int document_id, DocumentStatus status, const vector<int>& ratings) {
+    shards_[GetShardIndex(document_id)].UpdateDocument(document_id, status, ratings);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status, QueryMode mode) const {
+    return FindTopDocuments(execution::seq, raw_query, DocumentFilter(status), mode);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, const DocumentFilter& filter, QueryMode mode) const {
+    return FindTopDocuments(execution::seq, raw_query, filter, mode);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query) const {
+    return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, QueryMode mode) const {
+    return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL, mode);
+}
+
+matched_word_with_status ShardedSearchServer::MatchDocument(string_view raw_query, int document_id) const {
+    return shards_[GetShardIndex(document_id)].MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    return static_cast<int>(document_ids_.size());
+}
+
+set<int>::const_iterator ShardedSearchServer::begin() const {
+    return document_ids_.begin();
+}
+
+set<int>::const_iterator ShardedSearchServer::end() const {
+    return document_ids_.end();
+}
+
+const map<string_view, double>& ShardedSearchServer::GetWordFrequencies(int document_id) const {
+    return shards_[GetShardIndex(document_id)].GetWordFrequencies(document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    shards_[GetShardIndex(document_id)].RemoveDocument(document_id);
+    document_ids_.erase(document_id);
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    // Перемешиваем биты id, чтобы последовательные id равномерно расходились по шардам.
+    const uint64_t hash = static_cast<uint64_t>(static_cast<uint32_t>(document_id)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>((hash >> 32) % shards_.size());
+}
+
+const SearchServer& ShardedSearchServer::GetShard(size_t shard_index) const {
+    return shards_.at(shard_index);
+}
+
+void ShardedSearchServer::SaveShard(size_t shard_index, ostream& output) const {
+    shards_.at(shard_index).SaveSnapshot(output);
+}
+
+void ShardedSearchServer::RestoreShard(size_t shard_index, istream& input) {
+    SearchServer& shard = shards_.at(shard_index);
+    for (const int document_id : shard) {
+        document_ids_.erase(document_id);
+    }
+    shard.Clear();
+    try {
+        shard.LoadSnapshot(input);
+    } catch (...) {
+        shard.Clear();
+        throw;
+    }
+
+    for (const int document_id : shard) {
+        if (GetShardIndex(document_id) != shard_index) {
+            shard.Clear();
+            throw invalid_argument("DocumentID "s + to_string(document_id) + " does not belong to shard "s + to_string(shard_index) + "."s);
+        }
+    }
+    document_ids_.insert(shard.begin(), shard.end());
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include "search_server.h"
+#include <cstdint>
+#include <execution>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+// Индекс, разбитый по документам на несколько независимых SearchServer.
+// Документ попадает в шард по хешу id, запросы выполняются во всех шардах параллельно,
+// а их лучшие результаты сливаются. IDF считается по статистике всего корпуса,
+// поэтому ранжирование совпадает с одним SearchServer с теми же документами.
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer& stop_words, size_t shard_count);
+
+    ShardedSearchServer(const std::string& stop_words_text, size_t shard_count);
+
+    ShardedSearchServer(const ShardedSearchServer&) = delete;
+    ShardedSearchServer& operator=(const ShardedSearchServer&) = delete;
+
+    void AddDocument(int document_id, const std::string& document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+
+    void UpdateDocument(int document_id, const std::string& document, DocumentStatus status,
+                        const std::vector<int>& ratings);
+    void UpdateDocument(int document_id, DocumentStatus status, const std::vector<int>& ratings);
+
+    template <typename DocumentPredicate>
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                         QueryMode mode = QueryMode::ANY) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    [[nodiscard]] std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                         QueryMode mode = QueryMode::ANY) const;
+
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                                         QueryMode mode = QueryMode::ANY) const;
+
+    template <typename ExecutionPolicy>
+    [[nodiscard]] std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status,
+                                                         QueryMode mode = QueryMode::ANY) const;
+
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter,
+                                                         QueryMode mode = QueryMode::ANY) const;
+
+    template <typename ExecutionPolicy>
+    [[nodiscard]] std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentFilter& filter,
+                                                         QueryMode mode = QueryMode::ANY) const;
+
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, QueryMode mode) const;
+    template <typename ExecutionPolicy>
+    [[nodiscard]] std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query) const;
+    template <typename ExecutionPolicy>
+    [[nodiscard]] std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, QueryMode mode) const;
+
+    [[nodiscard]] matched_word_with_status MatchDocument(std::string_view raw_query, int document_id) const;
+    template <typename ExecutionPolicy>
+    [[nodiscard]] matched_word_with_status MatchDocument(const ExecutionPolicy& policy, std::string_view raw_query, int document_id) const;
+
+    [[nodiscard]] int GetDocumentCount() const;
+
+    [[nodiscard]] std::set<int>::const_iterator begin() const;
+    [[nodiscard]] std::set<int>::const_iterator end() const;
+
+    [[nodiscard]] const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+
+    void RemoveDocument(int document_id);
+
+    template <typename ExecutionPolicy>
+    void RemoveDocument(const ExecutionPolicy& policy, int document_id);
+
+    [[nodiscard]] size_t GetShardCount() const;
+    [[nodiscard]] size_t GetShardIndex(int document_id) const;
+    [[nodiscard]] const SearchServer& GetShard(size_t shard_index) const;
+
+    void SaveShard(size_t shard_index, std::ostream& output) const;
+    // Заменяет содержимое шарда снимком. Все документы снимка должны принадлежать этому шарду.
+    void RestoreShard(size_t shard_index, std::istream& input);
+
+private:
+    class GlobalStatistics : public CorpusStatistics {
+    public:
+        explicit GlobalStatistics(const std::vector<SearchServer>& shards);
+
+        [[nodiscard]] int GetDocumentCount() const override;
+        [[nodiscard]] int GetDocumentFrequency(std::string_view word) const override;
+
+    private:
+        const std::vector<SearchServer>& shards_;
+    };
+
+    std::vector<SearchServer> shards_;
+    GlobalStatistics statistics_;
+    std::set<int> document_ids_;
+
+    void ConnectShards();
+
+    template <typename ShardSearch>
+    std::vector<Document> SearchShards(ShardSearch shard_search) const;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const StringContainer& stop_words, size_t shard_count)
+        : statistics_(shards_) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive.");
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words);
+    }
+    ConnectShards();
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, QueryMode mode) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, mode);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate, QueryMode mode) const {
+    return SearchShards([&](const SearchServer& shard) {
+        return shard.FindTopDocuments(policy, raw_query, document_predicate, mode);
+    });
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status, QueryMode mode) const {
+    return FindTopDocuments(policy, raw_query, DocumentFilter(status), mode);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentFilter& filter, QueryMode mode) const {
+    return SearchShards([&](const SearchServer& shard) {
+        return shard.FindTopDocuments(policy, raw_query, filter, mode);
+    });
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, QueryMode mode) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL, mode);
+}
+
+template <typename ExecutionPolicy>
+matched_word_with_status ShardedSearchServer::MatchDocument(const ExecutionPolicy& policy, std::string_view raw_query, int document_id) const {
+    return shards_[GetShardIndex(document_id)].MatchDocument(policy, raw_query, document_id);
+}
+
+template <typename ExecutionPolicy>
+void ShardedSearchServer::RemoveDocument(const ExecutionPolicy& policy, int document_id) {
+    if (!document_ids_.count(document_id)) {
+        return;
+    }
+    shards_[GetShardIndex(document_id)].RemoveDocument(policy, document_id);
+    document_ids_.erase(document_id);
+}
+
+template <typename ShardSearch>
+std::vector<Document> ShardedSearchServer::SearchShards(ShardSearch shard_search) const {
+    std::vector<std::vector<Document>> shard_results(shards_.size());
+    std::transform(std::execution::par, shards_.begin(), shards_.end(), shard_results.begin(), shard_search);
+
+    std::vector<Document> matched_documents;
+    matched_documents.reserve(shards_.size() * MAX_RESULT_DOCUMENT_COUNT);
+    for (const auto& shard_result : shard_results) {
+        matched_documents.insert(matched_documents.end(), shard_result.begin(), shard_result.end());
+    }
+    std::sort(matched_documents.begin(), matched_documents.end(), SearchServer::IsMoreRelevant);
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return matched_documents;
+}
@@ -0,0 +1,103 @@
+#include "stop_word_filter.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t MAX_SEED_ATTEMPTS = 1u << 16;
+constexpr int MAX_BUILD_ATTEMPTS = 8;
+
+unsigned Log2(size_t power_of_two) {
+    return static_cast<unsigned>(__builtin_ctzll(power_of_two));
+}
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result *= 2;
+    }
+    return result;
+}
+
+}  // namespace
+
+StopWordFilter::StopWordFilter(const set<string>& stop_words)
+        : word_count_(stop_words.size()) {
+    vector<string_view> words(stop_words.begin(), stop_words.end());
+    vector<uint64_t> hashes;
+    hashes.reserve(words.size());
+    for (const string_view word : words) {
+        hashes.push_back(HashTerm(word));
+    }
+
+    // Слотов вдвое больше слов, в корзине в среднем четыре слова: зерно обычно находится за несколько попыток.
+    size_t slot_count = RoundUpToPowerOfTwo(max<size_t>(2, words.size() * 2));
+    bucket_seeds_.assign(RoundUpToPowerOfTwo(max<size_t>(1, words.size() / 4)), 0);
+    for (int attempt = 0; attempt < MAX_BUILD_ATTEMPTS; ++attempt, slot_count *= 2) {
+        slot_shift_ = 64 - Log2(slot_count);
+        slot_hashes_.assign(slot_count, 0);
+        slot_words_.assign(slot_count, string());
+        if (TryBuild(words, hashes)) {
+            return;
+        }
+    }
+    throw invalid_argument("Stop words cannot be placed into a perfect hash table: hash collision."s);
+}
+
+bool StopWordFilter::Contains(string_view word, uint64_t hash) const {
+    const size_t slot = GetSlot(hash, bucket_seeds_[GetBucket(hash)]);
+    return slot_hashes_[slot] == hash && !word.empty() && slot_words_[slot] == word;
+}
+
+size_t StopWordFilter::size() const {
+    return word_count_;
+}
+
+bool StopWordFilter::TryBuild(const vector<string_view>& words, const vector<uint64_t>& hashes) {
+    vector<vector<size_t>> buckets(bucket_seeds_.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+        buckets[GetBucket(hashes[i])].push_back(i);
+    }
+    vector<size_t> bucket_order(buckets.size());
+    iota(bucket_order.begin(), bucket_order.end(), 0);
+    sort(bucket_order.begin(), bucket_order.end(), [&buckets](size_t lhs, size_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    vector<bool> occupied(slot_hashes_.size(), false);
+    vector<size_t> slots;
+    for (const size_t bucket : bucket_order) {
+        if (buckets[bucket].empty()) {
+            break;
+        }
+        bool placed = false;
+        for (uint32_t seed = 0; seed < MAX_SEED_ATTEMPTS && !placed; ++seed) {
+            slots.clear();
+            placed = true;
+            for (const size_t word_index : buckets[bucket]) {
+                const size_t slot = GetSlot(hashes[word_index], seed);
+                if (occupied[slot] || find(slots.begin(), slots.end(), slot) != slots.end()) {
+                    placed = false;
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if (placed) {
+                bucket_seeds_[bucket] = seed;
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+        for (size_t k = 0; k < slots.size(); ++k) {
+            const size_t word_index = buckets[bucket][k];
+            occupied[slots[k]] = true;
+            slot_hashes_[slots[k]] = hashes[word_index];
+            slot_words_[slots[k]] = string(words[word_index]);
+        }
+    }
+    return true;
+}
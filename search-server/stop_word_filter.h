@@ -0,0 +1,40 @@
+#pragma once
+#include "string_processing.h"
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Множество стоп-слов, собранное при создании в совершенную хеш-таблицу (схема hash and displace):
+// хеш слова выбирает корзину, зерно корзины - слот. Зёрна подбираются так, чтобы все слова попали
+// в разные слоты, поэтому проверка слова - одно чтение зерна, один слот и одно сравнение строк.
+class StopWordFilter {
+public:
+    explicit StopWordFilter(const std::set<std::string>& stop_words);
+
+    [[nodiscard]] bool Contains(std::string_view word) const {
+        return Contains(word, HashTerm(word));
+    }
+
+    [[nodiscard]] bool Contains(std::string_view word, uint64_t hash) const;
+
+    [[nodiscard]] size_t size() const;
+
+private:
+    std::vector<uint32_t> bucket_seeds_;
+    std::vector<uint64_t> slot_hashes_;
+    std::vector<std::string> slot_words_;
+    size_t word_count_ = 0;
+    unsigned slot_shift_ = 63;
+
+    [[nodiscard]] size_t GetSlot(uint64_t hash, uint32_t seed) const {
+        return static_cast<size_t>(((hash ^ seed) * 0x9E3779B97F4A7C15ull) >> slot_shift_);
+    }
+
+    [[nodiscard]] size_t GetBucket(uint64_t hash) const {
+        return static_cast<size_t>(hash) & (bucket_seeds_.size() - 1);
+    }
+
+    [[nodiscard]] bool TryBuild(const std::vector<std::string_view>& words, const std::vector<uint64_t>& hashes);
+};
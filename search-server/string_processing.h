@@ -1,10 +1,18 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
 #include <set>
+#include <cstdint>
+#include <functional>
 
 std::vector<std::string> SplitIntoWords(const std::string_view text);
 
+// Хеш слова для словаря термов и фильтра стоп-слов.
+[[nodiscard]] inline uint64_t HashTerm(std::string_view word) {
+    return std::hash<std::string_view>{}(word);
+}
+
 template <typename StringContainer>
 std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string> non_empty_strings;
@@ -0,0 +1,86 @@
+#include "term_table.h"
+
+using namespace std;
+
+TermTable::TermTable()
+        : slots_(INITIAL_SLOT_COUNT) {
+}
+
+TermHandle TermTable::Find(string_view term, uint64_t hash) const {
+    const Slot& slot = slots_[FindSlot(term, hash)];
+    if (slot.entry == EMPTY_SLOT) {
+        return {hash, 0, nullptr};
+    }
+    const Entry& entry = entries_[slot.entry];
+    if (track_access_) {
+        entry.access_count.Increment();
+    }
+    const PostingList& postings = entry.postings;
+    return {hash, static_cast<int>(postings.size()), &postings};
+}
+
+PostingList* TermTable::FindPostings(string_view term) {
+    const Slot& slot = slots_[FindSlot(term, HashTerm(term))];
+    return slot.entry == EMPTY_SLOT ? nullptr : &entries_[slot.entry].postings;
+}
+
+PostingList& TermTable::Insert(string_view term, uint64_t hash) {
+    size_t position = FindSlot(term, hash);
+    if (slots_[position].entry != EMPTY_SLOT) {
+        return entries_[slots_[position].entry].postings;
+    }
+    if ((entries_.size() + 1) * 2 > slots_.size()) {
+        Grow();
+        position = FindSlot(term, hash);
+    }
+    slots_[position] = {hash, static_cast<uint32_t>(entries_.size())};
+    entries_.push_back({string(term), hash, PostingList(), AccessCounter()});
+    return entries_.back().postings;
+}
+
+size_t TermTable::size() const {
+    return entries_.size();
+}
+
+void TermTable::Clear() {
+    entries_.clear();
+    slots_.assign(INITIAL_SLOT_COUNT, Slot());
+}
+
+void TermTable::SetAccessTracking(bool enabled) {
+    track_access_ = enabled;
+}
+
+void TermTable::DecayAccessCounts() {
+    for (Entry& entry : entries_) {
+        entry.access_count.Set(entry.access_count.Get() / 2);
+    }
+}
+
+size_t TermTable::FindSlot(string_view term, uint64_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    size_t position = static_cast<size_t>(hash) & mask;
+    while (true) {
+        const Slot& slot = slots_[position];
+        if (slot.entry == EMPTY_SLOT || (slot.hash == hash && entries_[slot.entry].term == term)) {
+            return position;
+        }
+        position = (position + 1) & mask;
+    }
+}
+
+void TermTable::Grow() {
+    vector<Slot> slots(slots_.size() * 2);
+    const size_t mask = slots.size() - 1;
+    for (const Slot& slot : slots_) {
+        if (slot.entry == EMPTY_SLOT) {
+            continue;
+        }
+        size_t position = static_cast<size_t>(slot.hash) & mask;
+        while (slots[position].entry != EMPTY_SLOT) {
+            position = (position + 1) & mask;
+        }
+        slots[position] = slot;
+    }
+    slots_ = move(slots);
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include "posting_list.h"
+#include "string_processing.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Результат одного поиска терма в словаре: хеш, число документов с термом и его список вхождений.
+// Для отсутствующего терма postings == nullptr и document_frequency == 0.
+struct TermHandle {
+    uint64_t hash = 0;
+    int document_frequency = 0;
+    const PostingList* postings = nullptr;
+};
+
+// Счётчик обращений к терму. Увеличивается из константных поисков в нескольких потоках
+// и копируется значением, чтобы словарь оставался копируемым.
+class AccessCounter {
+public:
+    AccessCounter() = default;
+
+    AccessCounter(const AccessCounter& other)
+            : count_(other.Get()) {
+    }
+
+    AccessCounter& operator=(const AccessCounter& other) {
+        count_.store(other.Get(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    void Increment() const {
+        count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t Get() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    void Set(uint64_t count) {
+        count_.store(count, std::memory_order_relaxed);
+    }
+
+private:
+    mutable std::atomic<uint64_t> count_{0};
+};
+
+// Словарь термов: хеш-таблица с открытой адресацией и линейным пробированием.
+// Слоты хранят хеш терма, поэтому при поиске строки сравниваются только при совпадении хешей,
+// а при росте таблицы ничего не перехешируется. Записи лежат в deque: строки термов и списки
+// вхождений не перемещаются до Clear, на них можно ссылаться через string_view и указатели.
+class TermTable {
+public:
+    TermTable();
+
+    [[nodiscard]] TermHandle Find(std::string_view term) const {
+        return Find(term, HashTerm(term));
+    }
+
+    [[nodiscard]] TermHandle Find(std::string_view term, uint64_t hash) const;
+
+    // Список вхождений терма, nullptr если терма нет.
+    [[nodiscard]] PostingList* FindPostings(std::string_view term);
+
+    // Находит терм или добавляет его с пустым списком вхождений.
+    PostingList& Insert(std::string_view term, uint64_t hash);
+
+    PostingList& Insert(std::string_view term) {
+        return Insert(term, HashTerm(term));
+    }
+
+    [[nodiscard]] size_t size() const;
+
+    void Clear();
+
+    // Вызывает action(term, postings) для каждого терма в порядке добавления.
+    template <typename Action>
+    void ForEach(Action action) {
+        for (Entry& entry : entries_) {
+            action(std::string_view(entry.term), entry.postings);
+        }
+    }
+
+    // Включает подсчёт обращений: каждый Find найденного терма увеличивает его счётчик.
+    void SetAccessTracking(bool enabled);
+
+    // Вызывает action(postings, access_count) для каждого терма в порядке добавления.
+    template <typename Action>
+    void ForEachWithAccessCount(Action action) {
+        for (Entry& entry : entries_) {
+            action(entry.postings, entry.access_count.Get());
+        }
+    }
+
+    template <typename Action>
+    void ForEachWithAccessCount(Action action) const {
+        for (const Entry& entry : entries_) {
+            action(static_cast<const PostingList&>(entry.postings), entry.access_count.Get());
+        }
+    }
+
+    // Делит счётчики обращений пополам, чтобы старые обращения весили меньше новых.
+    void DecayAccessCounts();
+
+private:
+    struct Entry {
+        std::string term;
+        uint64_t hash;
+        PostingList postings;
+        AccessCounter access_count;
+    };
+
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t entry = EMPTY_SLOT;
+    };
+
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+    static constexpr size_t INITIAL_SLOT_COUNT = 16;
+
+    std::deque<Entry> entries_;
+    // Размер всегда степень двойки, заполнено не больше половины слотов.
+    std::vector<Slot> slots_;
+    bool track_access_ = false;
+
+    // Слот с термом или первый пустой слот на его пути пробирования.
+    [[nodiscard]] size_t FindSlot(std::string_view term, uint64_t hash) const;
+
+    void Grow();
+};
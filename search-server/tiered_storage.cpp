@@ -0,0 +1,77 @@
+#include "tiered_storage.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <numeric>
+#include <system_error>
+
+using namespace std;
+
+ostream& operator<<(ostream& output, const TieredStorageStats& stats) {
+    return output << "hot: "s << stats.hot_term_count << " terms, "s << stats.hot_bytes << " of "s << stats.memory_budget
+                  << " bytes, "s << stats.hot_accesses << " accesses; cold: "s << stats.cold_term_count << " terms, "s
+                  << stats.cold_bytes << " bytes ("s << stats.cold_resident_bytes << " resident), "s
+                  << stats.cold_accesses << " accesses; rebalances: "s << stats.rebalance_count;
+}
+
+vector<bool> ChooseHotTerms(const vector<TermDemand>& demands, size_t memory_budget) {
+    vector<size_t> order(demands.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&demands](size_t lhs, size_t rhs) {
+        if (demands[lhs].access_count != demands[rhs].access_count) {
+            return demands[lhs].access_count > demands[rhs].access_count;
+        }
+        return demands[lhs].bytes < demands[rhs].bytes;
+    });
+
+    vector<bool> hot(demands.size(), false);
+    size_t used = 0;
+    for (const size_t term : order) {
+        if (used + demands[term].bytes <= memory_budget) {
+            used += demands[term].bytes;
+            hot[term] = true;
+        }
+    }
+    return hot;
+}
+
+ColdPostingWriter::ColdPostingWriter(const string& path)
+        : path_(path), temp_path_(path + ".tmp"s), output_(temp_path_, ios::binary | ios::trunc) {
+    if (!output_) {
+        throw system_error(errno, generic_category(), "open "s + temp_path_);
+    }
+}
+
+ColdPostingLocation ColdPostingWriter::Append(const PostingList& postings) {
+    const size_t term_freq_size = postings.GetDataBytes() - postings.size() * sizeof(int);
+    ColdPostingLocation location;
+    location.document_ids_offset = offset_;
+    Write(postings.GetDocumentIdData(), postings.size() * sizeof(int));
+    location.term_freqs_offset = offset_;
+    Write(postings.GetTermFreqData(), term_freq_size);
+    return location;
+}
+
+shared_ptr<const MappedFile> ColdPostingWriter::Finish() {
+    output_.close();
+    if (!output_) {
+        throw system_error(errno, generic_category(), "write "s + temp_path_);
+    }
+    if (rename(temp_path_.c_str(), path_.c_str()) < 0) {
+        throw system_error(errno, generic_category(), "rename "s + temp_path_);
+    }
+    return make_shared<const MappedFile>(path_, MappedFileAccess::RANDOM);
+}
+
+void ColdPostingWriter::Write(const void* data, size_t size) {
+    constexpr size_t ALIGNMENT = 8;
+    static constexpr char PADDING[ALIGNMENT] = {};
+    output_.write(static_cast<const char*>(data), static_cast<streamsize>(size));
+    offset_ += size;
+    const size_t padding = (ALIGNMENT - offset_ % ALIGNMENT) % ALIGNMENT;
+    output_.write(PADDING, static_cast<streamsize>(padding));
+    offset_ += padding;
+    if (!output_) {
+        throw system_error(errno, generic_category(), "write "s + temp_path_);
+    }
+}
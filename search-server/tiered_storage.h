@@ -0,0 +1,71 @@
+#pragma once
+#include "mapped_file.h"
+#include "posting_list.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Многоуровневое хранение списков вхождений: горячие термы в памяти, холодные в файле cold_postings_path,
+// отображённом в память. memory_budget - сколько байт id и частот горячих списков можно держать в памяти.
+struct TieredStorageOptions {
+    std::string cold_postings_path;
+    size_t memory_budget = 0;
+};
+
+// Размещение списков вхождений и обращения к термам по уровням. Обращения считаются с последней
+// перестановки, более старые входят с весом 1/2, 1/4 и так далее.
+struct TieredStorageStats {
+    size_t memory_budget = 0;
+    size_t hot_term_count = 0;
+    size_t cold_term_count = 0;
+    size_t hot_bytes = 0;
+    size_t cold_bytes = 0;
+    // Сколько байт файла холодных списков сейчас в page cache.
+    size_t cold_resident_bytes = 0;
+    uint64_t hot_accesses = 0;
+    uint64_t cold_accesses = 0;
+    size_t rebalance_count = 0;
+};
+
+std::ostream& operator<<(std::ostream& output, const TieredStorageStats& stats);
+
+// Спрос терма на память: число обращений и размер списка вхождений.
+struct TermDemand {
+    uint64_t access_count = 0;
+    size_t bytes = 0;
+};
+
+// Выбирает горячие термы по убыванию числа обращений, пока их списки помещаются в memory_budget.
+// Каждое обращение к холодному терму читает его список целиком, поэтому байт бюджета, отданный терму,
+// экономит столько чтений из файла, сколько к терму обращений. При равенстве первыми идут короткие
+// списки, так в памяти остаётся больше термов. Пустые списки всегда горячие.
+[[nodiscard]] std::vector<bool> ChooseHotTerms(const std::vector<TermDemand>& demands, size_t memory_budget);
+
+struct ColdPostingLocation {
+    size_t document_ids_offset = 0;
+    size_t term_freqs_offset = 0;
+};
+
+// Пишет холодные списки во временный файл рядом с path и по Finish ставит его на место path.
+// Массивы выравниваются по 8 байт, чтобы частоты в double читались из отображения напрямую.
+class ColdPostingWriter {
+public:
+    explicit ColdPostingWriter(const std::string& path);
+
+    ColdPostingLocation Append(const PostingList& postings);
+
+    // Отображение уже открытого файла остаётся рабочим и после замены, пока его не закроют.
+    [[nodiscard]] std::shared_ptr<const MappedFile> Finish();
+
+private:
+    std::string path_;
+    std::string temp_path_;
+    std::ofstream output_;
+    size_t offset_ = 0;
+
+    void Write(const void* data, size_t size);
+};
@@ -0,0 +1,459 @@
+// Нагрузочный генератор для SearchServer внутри одного процесса.
+//
+// Строит индекс из сгенерированных документов и для каждого числа потоков из --threads запускает
+// столько клиентских потоков в замкнутом цикле: поток выполняет запрос, дожидается результата и берёт
+// следующий. Печатает QPS, перцентили и гистограмму задержек, в конце - сводку масштабирования.
+//
+//   load_generator [--threads 1,2,4,8] [--duration SEC] [--documents N] [--dictionary N]
+//                  [--document-words N] [--query-words N] [--queries N] [--minus-prob P] [--zipf S]
+//                  [--mix find=8,all=1,par=0,adaptive=0,match=1] [--rate QPS] [--ingest DOCS_PER_SEC]
+//                  [--request-queue] [--budget US] [--perf-counters] [--seed N]
+//
+// --zipf S      - слова документов и запросов выбираются по закону Ципфа с показателем S (0 - равномерно).
+// --mix         - веса видов операций: find (ANY), all (ALL), par (find с execution::par),
+//                 adaptive (find с adaptive_execution), match (MatchDocument случайного документа).
+// --rate QPS    - общая целевая частота запросов. Потоки отправляют запросы по расписанию, задержка
+//                 считается от запланированного момента, поэтому отставание от расписания входит в неё.
+// --ingest N    - отдельный поток добавляет N документов в секунду. SearchServer не допускает запись
+//                 одновременно с чтением, поэтому запросы берут shared_mutex на чтение, запись - на запись.
+// --request-queue - операции find идут через общий RequestQueue под мьютексом.
+// --budget US   - поиск идёт со сроком через US микросекунд после начала запроса, печатается число
+//                 частичных результатов. На операции через RequestQueue и match не действует.
+// --perf-counters - после каждого шага печатает аппаратные счётчики горячих функций по потокам.
+
+#include "../perf_counters.h"
+#include "../query_generator.h"
+#include "../request_queue.h"
+#include "../search_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <execution>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+enum class Operation {
+    FIND,
+    FIND_ALL,
+    FIND_PAR,
+    FIND_ADAPTIVE,
+    MATCH,
+};
+
+constexpr size_t OPERATION_COUNT = 5;
+constexpr string_view OPERATION_NAMES[OPERATION_COUNT] = {"find"sv, "all"sv, "par"sv, "adaptive"sv, "match"sv};
+
+struct LoadOptions {
+    vector<size_t> thread_counts;
+    double duration_seconds = 2.0;
+    int document_count = 10'000;
+    int dictionary_size = 1'000;
+    int document_words = 70;
+    int query_words = 7;
+    int query_count = 10'000;
+    double minus_prob = 0.1;
+    double zipf_exponent = 1.0;
+    vector<double> mix{8, 1, 0, 0, 1};
+    double rate = 0.0;
+    double ingest_rate = 0.0;
+    bool use_request_queue = false;
+    chrono::microseconds budget{0};
+    bool perf_counters = false;
+    unsigned seed = 5489u;
+};
+
+// Общий индекс. Блокировки берутся только при включённой записи, иначе они сами стали бы
+// узким местом и исказили бы масштабирование чтения.
+struct SharedIndex {
+    SearchServer server;
+    shared_mutex server_mutex;
+    optional<RequestQueue> request_queue;
+    mutex request_queue_mutex;
+    bool locking = false;
+    int next_document_id = 0;
+
+    explicit SharedIndex(const string& stop_words)
+            : server(stop_words) {
+    }
+};
+
+struct StepResult {
+    size_t thread_count = 0;
+    size_t errors = 0;
+    size_t partial_results = 0;
+    size_t documents_added = 0;
+    double seconds = 0.0;
+    // Задержки в микросекундах, по возрастанию.
+    vector<int64_t> latencies;
+
+    [[nodiscard]] double GetQps() const {
+        return seconds > 0 ? static_cast<double>(latencies.size()) / seconds : 0.0;
+    }
+
+    [[nodiscard]] int64_t GetPercentile(double fraction) const {
+        if (latencies.empty()) {
+            return 0;
+        }
+        return latencies[min(latencies.size() - 1, static_cast<size_t>(fraction * latencies.size()))];
+    }
+};
+
+vector<size_t> ParseThreadCounts(const string& text) {
+    vector<size_t> thread_counts;
+    istringstream input(text);
+    for (string item; getline(input, item, ',');) {
+        const size_t thread_count = stoul(item);
+        if (thread_count == 0) {
+            throw invalid_argument("Thread count must be positive"s);
+        }
+        thread_counts.push_back(thread_count);
+    }
+    return thread_counts;
+}
+
+// Степени двойки до удвоенного числа ядер, чтобы было видно и насыщение, и переподписку.
+vector<size_t> GetDefaultThreadCounts() {
+    const size_t core_count = max(1u, thread::hardware_concurrency());
+    vector<size_t> thread_counts;
+    for (size_t thread_count = 1; thread_count <= 2 * core_count; thread_count *= 2) {
+        thread_counts.push_back(thread_count);
+    }
+    return thread_counts;
+}
+
+vector<double> ParseMix(const string& text) {
+    vector<double> mix(OPERATION_COUNT, 0.0);
+    istringstream input(text);
+    for (string item; getline(input, item, ',');) {
+        const size_t separator = item.find('=');
+        if (separator == string::npos) {
+            throw invalid_argument("Mix item must look like name=weight: "s + item);
+        }
+        const string_view name = string_view(item).substr(0, separator);
+        const auto It = find(begin(OPERATION_NAMES), end(OPERATION_NAMES), name);
+        if (It == end(OPERATION_NAMES)) {
+            throw invalid_argument("Unknown operation in mix: "s + string(name));
+        }
+        const double weight = stod(item.substr(separator + 1));
+        if (weight < 0) {
+            throw invalid_argument("Mix weight must not be negative: "s + item);
+        }
+        mix[It - begin(OPERATION_NAMES)] = weight;
+    }
+    if (all_of(mix.begin(), mix.end(), [](double weight) { return weight == 0; })) {
+        throw invalid_argument("Mix has no operations"s);
+    }
+    return mix;
+}
+
+// Возвращает true, если результат поиска со сроком оказался частичным.
+bool ExecuteWithin(const SearchServer& server, Operation operation, const string& query, Clock::time_point deadline) {
+    switch (operation) {
+        case Operation::FIND_ALL:
+            return server.FindTopDocuments(query, deadline, QueryMode::ALL).partial;
+        case Operation::FIND_PAR:
+            return server.FindTopDocuments(execution::par, query, deadline).partial;
+        case Operation::FIND_ADAPTIVE:
+            return server.FindTopDocuments(adaptive_execution, query, deadline).partial;
+        default:
+            return server.FindTopDocuments(query, deadline).partial;
+    }
+}
+
+// Срок deadline учитывается только при has_budget.
+bool Execute(SharedIndex& index, Operation operation, const string& query, int document_id,
+             bool has_budget, Clock::time_point deadline) {
+    optional<shared_lock<shared_mutex>> lock;
+    if (index.locking) {
+        lock.emplace(index.server_mutex);
+    }
+    const SearchServer& server = index.server;
+    if (operation == Operation::FIND && index.request_queue) {
+        lock_guard queue_lock(index.request_queue_mutex);
+        [[maybe_unused]] const auto documents = index.request_queue->AddFindRequest(query);
+        return false;
+    }
+    if (operation == Operation::MATCH) {
+        [[maybe_unused]] const auto match = server.MatchDocument(query, document_id);
+        return false;
+    }
+    if (has_budget) {
+        return ExecuteWithin(server, operation, query, deadline);
+    }
+    vector<Document> documents;
+    switch (operation) {
+        case Operation::FIND_ALL:
+            documents = server.FindTopDocuments(query, QueryMode::ALL);
+            break;
+        case Operation::FIND_PAR:
+            documents = server.FindTopDocuments(execution::par, query);
+            break;
+        case Operation::FIND_ADAPTIVE:
+            documents = server.FindTopDocuments(adaptive_execution, query);
+            break;
+        default:
+            documents = server.FindTopDocuments(query);
+    }
+    return false;
+}
+
+StepResult RunStep(SharedIndex& index, const vector<string>& queries, const vector<string>& dictionary,
+                   const ZipfDistribution& word_distribution, const LoadOptions& options, size_t thread_count) {
+    const int match_document_count = options.document_count;
+    atomic<size_t> errors = 0;
+    atomic<size_t> partial_results = 0;
+    atomic<bool> stop = false;
+    vector<vector<int64_t>> latencies(thread_count);
+
+    const auto start = Clock::now();
+    const auto deadline = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.duration_seconds));
+
+    vector<thread> workers;
+    for (size_t worker = 0; worker < thread_count; ++worker) {
+        workers.emplace_back([&, worker] {
+            mt19937 generator(options.seed + static_cast<unsigned>(worker));
+            discrete_distribution<size_t> pick_operation(options.mix.begin(), options.mix.end());
+            uniform_int_distribution<size_t> pick_query(0, queries.size() - 1);
+            uniform_int_distribution<int> pick_document(0, match_document_count - 1);
+            // При заданной частоте каждый поток отвечает за свою долю и отправляет запросы по расписанию.
+            const auto interval = options.rate > 0
+                    ? chrono::duration_cast<Clock::duration>(chrono::duration<double>(thread_count / options.rate))
+                    : Clock::duration::zero();
+            auto& worker_latencies = latencies[worker];
+
+            for (size_t sent = 0;; ++sent) {
+                auto begin = Clock::now();
+                if (options.rate > 0) {
+                    const auto scheduled = start + interval * static_cast<Clock::rep>(sent);
+                    if (scheduled >= deadline) {
+                        break;
+                    }
+                    this_thread::sleep_until(scheduled);
+                    begin = scheduled;
+                } else if (begin >= deadline) {
+                    break;
+                }
+                const auto operation = static_cast<Operation>(pick_operation(generator));
+                try {
+                    const auto request_deadline = begin + options.budget;
+                    partial_results += Execute(index, operation, queries[pick_query(generator)], pick_document(generator),
+                                               options.budget.count() > 0, request_deadline);
+                } catch (const exception&) {
+                    ++errors;
+                }
+                worker_latencies.push_back(chrono::duration_cast<chrono::microseconds>(Clock::now() - begin).count());
+            }
+        });
+    }
+
+    size_t documents_added = 0;
+    thread writer;
+    if (options.ingest_rate > 0) {
+        writer = thread([&] {
+            mt19937 generator(options.seed - 1);
+            const auto interval = chrono::duration_cast<Clock::duration>(chrono::duration<double>(1.0 / options.ingest_rate));
+            for (auto next = start; !stop.load(memory_order_relaxed); next += interval) {
+                this_thread::sleep_until(next);
+                const string document = GenerateQuery(generator, dictionary, word_distribution, options.document_words);
+                unique_lock lock(index.server_mutex);
+                index.server.AddDocument(index.next_document_id++, document, DocumentStatus::ACTUAL, {1, 2, 3});
+                ++documents_added;
+            }
+        });
+    }
+
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    const double seconds = chrono::duration<double>(Clock::now() - start).count();
+    stop = true;
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    StepResult result;
+    result.thread_count = thread_count;
+    result.errors = errors;
+    result.partial_results = partial_results;
+    result.documents_added = documents_added;
+    result.seconds = seconds;
+    for (const auto& worker_latencies : latencies) {
+        result.latencies.insert(result.latencies.end(), worker_latencies.begin(), worker_latencies.end());
+    }
+    sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
+
+// Гистограмма по степеням двойки микросекунд, пустые края не печатаются.
+void PrintHistogram(const vector<int64_t>& latencies) {
+    if (latencies.empty()) {
+        return;
+    }
+    constexpr int BAR_WIDTH = 50;
+    vector<size_t> buckets;
+    for (const int64_t latency : latencies) {
+        size_t bucket = 0;
+        while ((int64_t{1} << bucket) <= latency) {
+            ++bucket;
+        }
+        if (bucket >= buckets.size()) {
+            buckets.resize(bucket + 1, 0);
+        }
+        ++buckets[bucket];
+    }
+    const size_t first = find_if(buckets.begin(), buckets.end(), [](size_t count) { return count > 0; }) - buckets.begin();
+    const size_t peak = *max_element(buckets.begin(), buckets.end());
+    for (size_t bucket = first; bucket < buckets.size(); ++bucket) {
+        const int64_t low = bucket == 0 ? 0 : int64_t{1} << (bucket - 1);
+        const int64_t high = int64_t{1} << bucket;
+        cout << "  "s << setw(8) << low << " .. "s << setw(8) << high << " us "s << setw(9) << buckets[bucket] << ' '
+             << string(buckets[bucket] * BAR_WIDTH / peak, '#') << '\n';
+    }
+}
+
+void PrintStep(const StepResult& result) {
+    cout << "threads = "s << result.thread_count << ": requests = "s << result.latencies.size()
+         << ", errors = "s << result.errors << ", qps = "s << static_cast<int64_t>(result.GetQps());
+    if (result.partial_results > 0) {
+        cout << ", partial = "s << result.partial_results;
+    }
+    if (result.documents_added > 0) {
+        cout << ", documents added = "s << result.documents_added;
+    }
+    cout << '\n';
+    cout << "latency us: p50 = "s << result.GetPercentile(0.5) << ", p90 = "s << result.GetPercentile(0.9)
+         << ", p99 = "s << result.GetPercentile(0.99) << ", p99.9 = "s << result.GetPercentile(0.999)
+         << ", max = "s << (result.latencies.empty() ? 0 : result.latencies.back()) << '\n';
+    PrintHistogram(result.latencies);
+    cout << endl;
+}
+
+// Ускорение считается относительно первого шага. Масштабирование кончается там, где qps перестаёт расти,
+// а p99 начинает.
+void PrintSummary(const vector<StepResult>& results) {
+    cout << "threads         qps   speedup    p50 us    p99 us\n"s;
+    const double base_qps = results.front().GetQps();
+    for (const StepResult& result : results) {
+        cout << setw(7) << result.thread_count << setw(12) << static_cast<int64_t>(result.GetQps())
+             << setw(10) << fixed << setprecision(2) << (base_qps > 0 ? result.GetQps() / base_qps : 0.0)
+             << setw(10) << result.GetPercentile(0.5) << setw(10) << result.GetPercentile(0.99) << '\n';
+    }
+    cout << defaultfloat << flush;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    LoadOptions options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const string_view option = argv[i];
+            const bool has_value = i + 1 < argc;
+            if (option == "--threads"sv && has_value) {
+                options.thread_counts = ParseThreadCounts(argv[++i]);
+            } else if (option == "--duration"sv && has_value) {
+                options.duration_seconds = stod(argv[++i]);
+            } else if (option == "--documents"sv && has_value) {
+                options.document_count = stoi(argv[++i]);
+            } else if (option == "--dictionary"sv && has_value) {
+                options.dictionary_size = stoi(argv[++i]);
+            } else if (option == "--document-words"sv && has_value) {
+                options.document_words = stoi(argv[++i]);
+            } else if (option == "--query-words"sv && has_value) {
+                options.query_words = stoi(argv[++i]);
+            } else if (option == "--queries"sv && has_value) {
+                options.query_count = stoi(argv[++i]);
+            } else if (option == "--minus-prob"sv && has_value) {
+                options.minus_prob = stod(argv[++i]);
+            } else if (option == "--zipf"sv && has_value) {
+                options.zipf_exponent = stod(argv[++i]);
+            } else if (option == "--mix"sv && has_value) {
+                options.mix = ParseMix(argv[++i]);
+            } else if (option == "--rate"sv && has_value) {
+                options.rate = stod(argv[++i]);
+            } else if (option == "--ingest"sv && has_value) {
+                options.ingest_rate = stod(argv[++i]);
+            } else if (option == "--request-queue"sv) {
+                options.use_request_queue = true;
+            } else if (option == "--budget"sv && has_value) {
+                options.budget = chrono::microseconds(stol(argv[++i]));
+            } else if (option == "--perf-counters"sv) {
+                options.perf_counters = true;
+            } else if (option == "--seed"sv && has_value) {
+                options.seed = static_cast<unsigned>(stoul(argv[++i]));
+            } else {
+                cerr << "Unknown option or missing value: "s << option << endl;
+                return 1;
+            }
+        }
+        if (options.document_count <= 0 || options.query_count <= 0 || options.dictionary_size <= 0) {
+            throw invalid_argument("--documents, --queries and --dictionary must be positive"s);
+        }
+        if (options.thread_counts.empty()) {
+            options.thread_counts = GetDefaultThreadCounts();
+        }
+
+        mt19937 generator(options.seed);
+        const vector<string> dictionary = GenerateDictionary(generator, options.dictionary_size, 10);
+        const ZipfDistribution word_distribution(dictionary.size(), options.zipf_exponent);
+
+        // Самое частое слово словаря - стоп-слово, как в main.cpp.
+        SharedIndex index(dictionary[0]);
+        index.locking = options.ingest_rate > 0;
+        for (int id = 0; id < options.document_count; ++id) {
+            index.server.AddDocument(id, GenerateQuery(generator, dictionary, word_distribution, options.document_words),
+                                     DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        index.next_document_id = options.document_count;
+        if (options.use_request_queue) {
+            index.request_queue.emplace(index.server);
+        }
+        const vector<string> queries = GenerateQueries(generator, dictionary, word_distribution, options.query_count,
+                                                       options.query_words, options.minus_prob);
+        cout << "documents = "s << options.document_count << ", dictionary = "s << dictionary.size()
+             << ", zipf = "s << options.zipf_exponent << ", mix ="s;
+        for (size_t operation = 0; operation < OPERATION_COUNT; ++operation) {
+            if (options.mix[operation] > 0) {
+                cout << ' ' << OPERATION_NAMES[operation] << '=' << options.mix[operation];
+            }
+        }
+        cout << '\n' << endl;
+
+        vector<StepResult> results;
+        for (const size_t thread_count : options.thread_counts) {
+            if (options.perf_counters) {
+                PerfProfiler::Reset();
+                PerfProfiler::Enable();
+            }
+            results.push_back(RunStep(index, queries, dictionary, word_distribution, options, thread_count));
+            if (options.perf_counters) {
+                PerfProfiler::Disable();
+            }
+            PrintStep(results.back());
+            if (options.perf_counters) {
+                cout << PerfProfiler::GetReport() << endl;
+            }
+        }
+        PrintSummary(results);
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    return 0;
+}
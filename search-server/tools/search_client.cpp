@@ -0,0 +1,331 @@
+// Клиент и нагрузочный инструмент для search_daemon.
+//
+// Одиночные запросы:
+//   search_client --socket PATH find "query" [--status N] [--all]
+//   search_client --socket PATH match ID "query"
+//   search_client --socket PATH add ID STATUS "1 2 3" "text"
+//   search_client --socket PATH update ID STATUS "1 2 3" ["text"]
+//   search_client --socket PATH remove ID
+// Нагрузка: каждое соединение держит до DEPTH запросов в полёте.
+//   search_client --socket PATH bench QUERIES_FILE [--requests N] [--connections C] [--pipeline DEPTH]
+// Вместо --socket можно указать --tcp PORT для подключения к 127.0.0.1.
+
+#include "../search_protocol.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Endpoint {
+    string socket_path;
+    int tcp_port = 0;
+};
+
+class DaemonClient {
+public:
+    explicit DaemonClient(const Endpoint& endpoint) {
+        if (!endpoint.socket_path.empty()) {
+            fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            strncpy(address.sun_path, endpoint.socket_path.c_str(), sizeof(address.sun_path) - 1);
+            Connect(reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        } else {
+            fd_ = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(static_cast<uint16_t>(endpoint.tcp_port));
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            Connect(reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        }
+    }
+
+    DaemonClient(const DaemonClient&) = delete;
+    DaemonClient& operator=(const DaemonClient&) = delete;
+
+    ~DaemonClient() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    void Send(const Request& request) {
+        string frame;
+        EncodeRequest(request, frame);
+        size_t sent_total = 0;
+        while (sent_total < frame.size()) {
+            const ssize_t sent = send(fd_, frame.data() + sent_total, frame.size() - sent_total, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw system_error(errno, generic_category(), "send");
+            }
+            sent_total += static_cast<size_t>(sent);
+        }
+    }
+
+    Response Receive() {
+        while (true) {
+            const auto body_size = PeekFrameBodySize(input_);
+            if (body_size && input_.size() >= FRAME_HEADER_SIZE + *body_size) {
+                Response response = DecodeResponse(string_view(input_).substr(FRAME_HEADER_SIZE, *body_size));
+                input_.erase(0, FRAME_HEADER_SIZE + *body_size);
+                return response;
+            }
+            char chunk[64 * 1024];
+            const ssize_t received = read(fd_, chunk, sizeof(chunk));
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received <= 0) {
+                throw runtime_error("Connection closed by daemon");
+            }
+            input_.append(chunk, static_cast<size_t>(received));
+        }
+    }
+
+private:
+    int fd_ = -1;
+    string input_;
+
+    void Connect(const sockaddr* address, socklen_t size) {
+        if (fd_ < 0 || connect(fd_, address, size) < 0) {
+            throw system_error(errno, generic_category(), "connect");
+        }
+    }
+};
+
+void PrintResponse(const Response& response) {
+    if (response.code == ResponseCode::ERROR) {
+        cout << "error: "s << response.error << endl;
+        return;
+    }
+    switch (response.type) {
+        case RequestType::FIND:
+            for (const Document& document : response.documents) {
+                cout << "{ "s << document << " }"s << endl;
+            }
+            break;
+        case RequestType::MATCH:
+            cout << "status = "s << static_cast<int>(response.status) << " words ="s;
+            for (const string& word : response.words) {
+                cout << ' ' << word;
+            }
+            cout << endl;
+            break;
+        case RequestType::ADD:
+        case RequestType::REMOVE:
+        case RequestType::UPDATE:
+        case RequestType::UPDATE_ATTRIBUTES:
+            cout << "ok"s << endl;
+            break;
+    }
+}
+
+DocumentStatus ParseStatus(const string& text) {
+    const int status = stoi(text);
+    if (status < 0 || status >= static_cast<int>(DocumentAttributes::STATUS_COUNT)) {
+        throw invalid_argument("Document status must be from 0 to "s
+                               + to_string(DocumentAttributes::STATUS_COUNT - 1) + ": "s + text);
+    }
+    return static_cast<DocumentStatus>(status);
+}
+
+vector<string> ReadQueries(const string& path) {
+    ifstream input(path);
+    if (!input) {
+        throw invalid_argument("Cannot open queries file "s + path);
+    }
+    vector<string> queries;
+    for (string line; getline(input, line);) {
+        if (!line.empty()) {
+            queries.push_back(line);
+        }
+    }
+    if (queries.empty()) {
+        throw invalid_argument("Queries file is empty"s);
+    }
+    return queries;
+}
+
+void RunBench(const Endpoint& endpoint, const vector<string>& queries, size_t request_count,
+              size_t connection_count, size_t pipeline_depth) {
+    using Clock = chrono::steady_clock;
+    vector<vector<int64_t>> latencies(connection_count);
+    atomic<size_t> errors = 0;
+
+    const auto start = Clock::now();
+    vector<thread> workers;
+    for (size_t worker = 0; worker < connection_count; ++worker) {
+        workers.emplace_back([&, worker] {
+            const size_t first = request_count * worker / connection_count;
+            const size_t last = request_count * (worker + 1) / connection_count;
+            vector<Clock::time_point> sent_at(last - first);
+            auto& worker_latencies = latencies[worker];
+            worker_latencies.reserve(last - first);
+            // Исключение из потока завершило бы весь процесс: сбой соединения считается ошибкой
+            // для всех запросов потока, на которые не пришёл ответ.
+            try {
+                DaemonClient client(endpoint);
+
+                size_t next_to_send = first;
+                auto send_next = [&] {
+                    Request request;
+                    request.type = RequestType::FIND;
+                    request.request_id = static_cast<uint32_t>(next_to_send);
+                    request.text = queries[next_to_send % queries.size()];
+                    sent_at[next_to_send - first] = Clock::now();
+                    client.Send(request);
+                    ++next_to_send;
+                };
+                while (next_to_send < last && next_to_send - first < pipeline_depth) {
+                    send_next();
+                }
+                for (size_t received = first; received < last; ++received) {
+                    const Response response = client.Receive();
+                    worker_latencies.push_back(chrono::duration_cast<chrono::microseconds>(
+                            Clock::now() - sent_at[response.request_id - first]).count());
+                    if (response.code == ResponseCode::ERROR) {
+                        ++errors;
+                    }
+                    if (next_to_send < last) {
+                        send_next();
+                    }
+                }
+            } catch (const exception& error) {
+                errors += last - first - worker_latencies.size();
+                cerr << "connection "s + to_string(worker) + ": "s + error.what() + "\n"s;
+            }
+        });
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    const double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    vector<int64_t> all_latencies;
+    for (const auto& worker_latencies : latencies) {
+        all_latencies.insert(all_latencies.end(), worker_latencies.begin(), worker_latencies.end());
+    }
+    sort(all_latencies.begin(), all_latencies.end());
+    auto percentile = [&all_latencies](double fraction) -> int64_t {
+        if (all_latencies.empty()) {
+            return 0;
+        }
+        return all_latencies[min(all_latencies.size() - 1, static_cast<size_t>(fraction * all_latencies.size()))];
+    };
+    cout << "requests = "s << all_latencies.size() << ", errors = "s << errors.load()
+         << ", qps = "s << static_cast<int64_t>(all_latencies.size() / seconds) << endl;
+    cout << "latency us: p50 = "s << percentile(0.5) << ", p90 = "s << percentile(0.9)
+         << ", p99 = "s << percentile(0.99) << ", max = "s << percentile(1.0) << endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Endpoint endpoint;
+    vector<string> arguments;
+    size_t request_count = 10'000;
+    size_t connection_count = 1;
+    size_t pipeline_depth = 16;
+    string status = "0"s;
+    QueryMode mode = QueryMode::ANY;
+    for (int i = 1; i < argc; ++i) {
+        const string_view option = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (option == "--socket"sv && has_value) {
+            endpoint.socket_path = argv[++i];
+        } else if (option == "--tcp"sv && has_value) {
+            endpoint.tcp_port = stoi(argv[++i]);
+        } else if (option == "--requests"sv && has_value) {
+            request_count = stoul(argv[++i]);
+        } else if (option == "--connections"sv && has_value) {
+            connection_count = max<size_t>(1, stoul(argv[++i]));
+        } else if (option == "--pipeline"sv && has_value) {
+            pipeline_depth = max<size_t>(1, stoul(argv[++i]));
+        } else if (option == "--status"sv && has_value) {
+            status = argv[++i];
+        } else if (option == "--all"sv) {
+            mode = QueryMode::ALL;
+        } else {
+            arguments.emplace_back(option);
+        }
+    }
+    if ((endpoint.socket_path.empty() && endpoint.tcp_port == 0) || arguments.empty()) {
+        cerr << "Usage: search_client (--socket PATH | --tcp PORT) find|match|add|update|remove|bench ..."s << endl;
+        return 1;
+    }
+
+    try {
+        const string& command = arguments[0];
+        if (command == "bench"s && arguments.size() == 2) {
+            RunBench(endpoint, ReadQueries(arguments[1]), request_count, connection_count, pipeline_depth);
+            return 0;
+        }
+
+        Request request;
+        if (command == "find"s && arguments.size() == 2) {
+            request.type = RequestType::FIND;
+            request.status = ParseStatus(status);
+            request.mode = mode;
+            request.text = arguments[1];
+        } else if (command == "match"s && arguments.size() == 3) {
+            request.type = RequestType::MATCH;
+            request.document_id = stoi(arguments[1]);
+            request.text = arguments[2];
+        } else if (command == "add"s && arguments.size() == 5) {
+            request.type = RequestType::ADD;
+            request.document_id = stoi(arguments[1]);
+            request.status = ParseStatus(arguments[2]);
+            istringstream ratings(arguments[3]);
+            for (int rating; ratings >> rating;) {
+                request.ratings.push_back(rating);
+            }
+            request.text = arguments[4];
+        } else if (command == "update"s && (arguments.size() == 4 || arguments.size() == 5)) {
+            request.type = arguments.size() == 5 ? RequestType::UPDATE : RequestType::UPDATE_ATTRIBUTES;
+            request.document_id = stoi(arguments[1]);
+            request.status = ParseStatus(arguments[2]);
+            istringstream ratings(arguments[3]);
+            for (int rating; ratings >> rating;) {
+                request.ratings.push_back(rating);
+            }
+            if (arguments.size() == 5) {
+                request.text = arguments[4];
+            }
+        } else if (command == "remove"s && arguments.size() == 2) {
+            request.type = RequestType::REMOVE;
+            request.document_id = stoi(arguments[1]);
+        } else {
+            cerr << "Unknown command or wrong number of arguments: "s << command << endl;
+            return 1;
+        }
+        DaemonClient client(endpoint);
+        client.Send(request);
+        PrintResponse(client.Receive());
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    return 0;
+}
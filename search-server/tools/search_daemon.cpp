@@ -0,0 +1,578 @@
+// Поисковый демон: держит один индекс и обслуживает запросы find/match/add/update/remove
+// по протоколу из search_protocol.h через Unix domain socket и, опционально, TCP на localhost.
+//
+// Запуск:
+//   search_daemon --socket /tmp/search.sock [--tcp 7700] [--corpus corpus.tsv] [--stop-words "and in on"]
+//                 [--cold-postings /var/tmp/cold.bin --memory-budget 1073741824]
+//
+// С --cold-postings списки вхождений, не поместившиеся в --memory-budget байт, читаются из файла,
+// а раскладка по уровням пересчитывается каждые REBALANCE_PERIOD запросов find.
+//
+// Файл корпуса - по документу на строку: id<TAB>статус<TAB>рейтинги через пробел<TAB>текст.
+
+#include "../corpus_loader.h"
+#include "../search_protocol.h"
+#include "../search_server.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <execution>
+#include <iostream>
+#include <map>
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+volatile sig_atomic_t stop_requested = 0;
+
+void HandleStopSignal(int) {
+    stop_requested = 1;
+}
+
+void ThrowSystemError(const string& what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+void SetNonBlocking(int fd) {
+    const int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        ThrowSystemError("fcntl");
+    }
+}
+
+int ListenUnix(const string& path) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        ThrowSystemError("socket");
+    }
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("Socket path is too long: "s + path);
+    }
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        ThrowSystemError("bind " + path);
+    }
+    SetNonBlocking(fd);
+    return fd;
+}
+
+int ListenTcp(uint16_t port) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        ThrowSystemError("socket");
+    }
+    const int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        ThrowSystemError("bind 127.0.0.1:" + to_string(port));
+    }
+    SetNonBlocking(fd);
+    return fd;
+}
+
+struct Connection {
+    int fd = -1;
+    string input;
+    string output;
+    uint32_t watched_events = EPOLLIN;
+    bool peer_closed = false;
+};
+
+struct PendingRequest {
+    uint64_t connection_id;
+    Request request;
+    // Непустая, если запрос отклонён при разборе: он не выполняется, в ответ уходит эта ошибка.
+    string error;
+};
+
+class SearchDaemon {
+public:
+    explicit SearchDaemon(SearchServer& search_server)
+            : search_server_(search_server) {
+        epoll_fd_ = epoll_create1(0);
+        if (epoll_fd_ < 0) {
+            ThrowSystemError("epoll_create1");
+        }
+        spare_fd_ = OpenSpareFd();
+    }
+
+    ~SearchDaemon() {
+        for (auto& [id, connection] : connections_) {
+            close(connection.fd);
+        }
+        for (const int fd : listen_fds_) {
+            close(fd);
+        }
+        if (spare_fd_ >= 0) {
+            close(spare_fd_);
+        }
+        close(epoll_fd_);
+    }
+
+    void AddListener(int fd) {
+        listen_fds_.push_back(fd);
+        Watch(fd, LISTENER_TAG_BASE + listen_fds_.size() - 1, EPOLLIN);
+    }
+
+    void Run() {
+        vector<epoll_event> events(256);
+        while (!stop_requested) {
+            const int ready = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), -1);
+            if (ready < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ThrowSystemError("epoll_wait");
+            }
+            for (int i = 0; i < ready; ++i) {
+                const uint64_t tag = events[i].data.u64;
+                if (tag >= LISTENER_TAG_BASE) {
+                    Accept(listen_fds_[tag - LISTENER_TAG_BASE]);
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    ReadFrom(tag);
+                }
+                if (events[i].events & EPOLLOUT) {
+                    Flush(tag);
+                }
+            }
+            ExecutePending();
+            CloseFinishedConnections();
+        }
+    }
+
+private:
+    // Теги слушающих сокетов в epoll_event::data лежат выше любых id соединений.
+    static constexpr uint64_t LISTENER_TAG_BASE = uint64_t{1} << 62;
+    static constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+    // За одно пробуждение с соединения читается не больше этого, остальное дочитается на следующем круге,
+    // чтобы один клиент не задерживал остальных.
+    static constexpr size_t MAX_READ_PER_WAKEUP = 4 * READ_CHUNK_SIZE;
+    // Пока неотправленных ответов больше этого, запросы соединения не читаются: клиент, который шлёт
+    // запросы и не забирает ответы, упирается в буфер сокета, а не в память демона.
+    static constexpr size_t OUTPUT_HIGH_WATER = 4 * 1024 * 1024;
+    // Недочитанный кадр не длиннее этого, иначе PeekFrameBodySize отвергнет его.
+    static constexpr size_t INPUT_HIGH_WATER = FRAME_HEADER_SIZE + MAX_FRAME_BODY_SIZE;
+
+    static constexpr size_t REBALANCE_PERIOD = 100'000;
+
+    SearchServer& search_server_;
+    size_t finds_since_rebalance_ = 0;
+    int epoll_fd_ = -1;
+    vector<int> listen_fds_;
+    // Запасной дескриптор на случай, когда дескрипторы кончились: см. RejectPendingConnection.
+    int spare_fd_ = -1;
+    bool listeners_paused_ = false;
+    map<uint64_t, Connection> connections_;
+    uint64_t next_connection_id_ = 0;
+    vector<PendingRequest> pending_;
+
+    void Watch(int fd, uint64_t tag, uint32_t events, int operation = EPOLL_CTL_ADD) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = tag;
+        if (epoll_ctl(epoll_fd_, operation, fd, &event) < 0) {
+            ThrowSystemError("epoll_ctl");
+        }
+    }
+
+    static int OpenSpareFd() {
+        return open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+
+    void Accept(int listen_fd) {
+        while (true) {
+            const int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EMFILE || errno == ENFILE) {
+                    if (RejectPendingConnection(listen_fd)) {
+                        continue;
+                    }
+                } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    cerr << "accept: "s << strerror(errno) << endl;
+                }
+                return;
+            }
+            SetNonBlocking(fd);
+            const uint64_t connection_id = next_connection_id_++;
+            connections_[connection_id].fd = fd;
+            Watch(fd, connection_id, EPOLLIN);
+        }
+    }
+
+    // Дескрипторы кончились, а соединение так и лежит в очереди listen: level-triggered epoll будил бы
+    // на нём в каждом круге. Запасной дескриптор освобождается, чтобы принять соединение и сразу закрыть.
+    // Если вернуть запасной не удалось, слушающие сокеты снимаются с наблюдения до закрытия какого-нибудь
+    // соединения. Возвращает true, если соединение отклонено и можно принимать дальше.
+    bool RejectPendingConnection(int listen_fd) {
+        const int error = errno;
+        if (spare_fd_ >= 0) {
+            close(spare_fd_);
+            const int fd = accept(listen_fd, nullptr, nullptr);
+            const int accept_error = errno;
+            if (fd >= 0) {
+                close(fd);
+            }
+            spare_fd_ = OpenSpareFd();
+            if (spare_fd_ >= 0 && fd >= 0) {
+                cerr << "accept: "s << strerror(error) << ", connection rejected"s << endl;
+                return true;
+            }
+            // Без свободного дескриптора accept сообщает EMFILE и при пустой очереди.
+            if (spare_fd_ >= 0 && (accept_error == EAGAIN || accept_error == EWOULDBLOCK)) {
+                return false;
+            }
+        }
+        cerr << "accept: "s << strerror(error) << ", not accepting until a connection closes"s << endl;
+        SetListenersPaused(true);
+        return false;
+    }
+
+    void SetListenersPaused(bool paused) {
+        if (listeners_paused_ == paused) {
+            return;
+        }
+        listeners_paused_ = paused;
+        for (size_t i = 0; i < listen_fds_.size(); ++i) {
+            Watch(listen_fds_[i], LISTENER_TAG_BASE + i, paused ? 0u : static_cast<uint32_t>(EPOLLIN), EPOLL_CTL_MOD);
+        }
+    }
+
+    void CloseConnection(uint64_t connection_id) {
+        const auto It = connections_.find(connection_id);
+        if (It == connections_.end()) {
+            return;
+        }
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, It->second.fd, nullptr);
+        close(It->second.fd);
+        connections_.erase(It);
+        if (listeners_paused_) {
+            if (spare_fd_ < 0) {
+                spare_fd_ = OpenSpareFd();
+            }
+            SetListenersPaused(false);
+        }
+    }
+
+    void ReadFrom(uint64_t connection_id) {
+        const auto It = connections_.find(connection_id);
+        if (It == connections_.end()) {
+            return;
+        }
+        Connection& connection = It->second;
+        if (IsOverHighWater(connection)) {
+            return;
+        }
+        char chunk[READ_CHUNK_SIZE];
+        size_t received_total = 0;
+        while (received_total < MAX_READ_PER_WAKEUP) {
+            const ssize_t received = read(connection.fd, chunk, sizeof(chunk));
+            if (received > 0) {
+                connection.input.append(chunk, static_cast<size_t>(received));
+                received_total += static_cast<size_t>(received);
+                continue;
+            }
+            if (received == 0) {
+                // Клиент закрыл свою сторону: дочитываем кадры и закрываемся после отправки ответов.
+                connection.peer_closed = true;
+                UpdateInterest(connection_id, connection);
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            CloseConnection(connection_id);
+            return;
+        }
+
+        // В буфере может быть несколько кадров подряд: клиент шлёт запросы конвейером.
+        size_t consumed = 0;
+        try {
+            while (true) {
+                const string_view rest = string_view(connection.input).substr(consumed);
+                const auto body_size = PeekFrameBodySize(rest);
+                if (!body_size || rest.size() < FRAME_HEADER_SIZE + *body_size) {
+                    break;
+                }
+                try {
+                    pending_.push_back({connection_id, DecodeRequest(rest.substr(FRAME_HEADER_SIZE, *body_size)), {}});
+                } catch (const InvalidRequestError& error) {
+                    // Границы кадра известны, поэтому соединение остаётся рабочим.
+                    Request request;
+                    request.type = error.GetType();
+                    request.request_id = error.GetRequestId();
+                    pending_.push_back({connection_id, move(request), error.what()});
+                }
+                consumed += FRAME_HEADER_SIZE + *body_size;
+            }
+        } catch (const ProtocolError& error) {
+            cerr << "Closing connection "s << connection_id << ": "s << error.what() << endl;
+            CloseConnection(connection_id);
+            return;
+        }
+        connection.input.erase(0, consumed);
+        UpdateInterest(connection_id, connection);
+    }
+
+    void Flush(uint64_t connection_id) {
+        const auto It = connections_.find(connection_id);
+        if (It == connections_.end()) {
+            return;
+        }
+        Connection& connection = It->second;
+        size_t sent_total = 0;
+        while (sent_total < connection.output.size()) {
+            const ssize_t sent = send(connection.fd, connection.output.data() + sent_total,
+                                      connection.output.size() - sent_total, MSG_NOSIGNAL);
+            if (sent > 0) {
+                sent_total += static_cast<size_t>(sent);
+                continue;
+            }
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            CloseConnection(connection_id);
+            return;
+        }
+        connection.output.erase(0, sent_total);
+        UpdateInterest(connection_id, connection);
+    }
+
+    static bool IsOverHighWater(const Connection& connection) {
+        return connection.output.size() >= OUTPUT_HIGH_WATER || connection.input.size() >= INPUT_HIGH_WATER;
+    }
+
+    void UpdateInterest(uint64_t connection_id, Connection& connection) {
+        uint32_t events = connection.peer_closed || IsOverHighWater(connection) ? 0u : static_cast<uint32_t>(EPOLLIN);
+        if (!connection.output.empty()) {
+            events |= EPOLLOUT;
+        }
+        if (events != connection.watched_events) {
+            connection.watched_events = events;
+            Watch(connection.fd, connection_id, events, EPOLL_CTL_MOD);
+        }
+    }
+
+    void CloseFinishedConnections() {
+        vector<uint64_t> finished;
+        for (const auto& [connection_id, connection] : connections_) {
+            if (connection.peer_closed && connection.output.empty()) {
+                finished.push_back(connection_id);
+            }
+        }
+        for (const uint64_t connection_id : finished) {
+            CloseConnection(connection_id);
+        }
+    }
+
+    Response ExecuteReadOnly(const PendingRequest& pending) const {
+        const Request& request = pending.request;
+        Response response;
+        response.type = request.type;
+        response.request_id = request.request_id;
+        if (!pending.error.empty()) {
+            response.code = ResponseCode::ERROR;
+            response.error = pending.error;
+            return response;
+        }
+        try {
+            if (request.type == RequestType::FIND) {
+                response.documents = search_server_.FindTopDocuments(request.text, request.status, request.mode);
+            } else {
+                const auto [words, status] = search_server_.MatchDocument(request.text, request.document_id);
+                response.words.assign(words.begin(), words.end());
+                response.status = status;
+            }
+        } catch (const exception& error) {
+            response.code = ResponseCode::ERROR;
+            response.error = error.what();
+        }
+        return response;
+    }
+
+    Response ExecuteUpdate(const Request& request) {
+        Response response;
+        response.type = request.type;
+        response.request_id = request.request_id;
+        try {
+            if (request.type == RequestType::ADD) {
+                search_server_.AddDocument(request.document_id, request.text, request.status, request.ratings);
+            } else if (request.type == RequestType::UPDATE) {
+                search_server_.UpdateDocument(request.document_id, request.text, request.status, request.ratings);
+            } else if (request.type == RequestType::UPDATE_ATTRIBUTES) {
+                search_server_.UpdateDocument(request.document_id, request.status, request.ratings);
+            } else {
+                search_server_.RemoveDocument(request.document_id);
+            }
+        } catch (const exception& error) {
+            response.code = ResponseCode::ERROR;
+            response.error = error.what();
+        }
+        return response;
+    }
+
+    // Запросы выполняются в порядке поступления. Подряд идущие find и match не меняют индекс,
+    // поэтому собираются в пакет и выполняются параллельно; add и remove разделяют пакеты.
+    void ExecutePending() {
+        if (pending_.empty()) {
+            return;
+        }
+        vector<Response> responses(pending_.size());
+        size_t batch_begin = 0;
+        while (batch_begin < pending_.size()) {
+            size_t batch_end = batch_begin;
+            while (batch_end < pending_.size() && IsReadOnly(pending_[batch_end])) {
+                ++batch_end;
+            }
+            if (batch_end > batch_begin) {
+                finds_since_rebalance_ += batch_end - batch_begin;
+                transform(execution::par, pending_.begin() + batch_begin, pending_.begin() + batch_end,
+                          responses.begin() + batch_begin,
+                          [this](const PendingRequest& pending) {
+                              return ExecuteReadOnly(pending);
+                          });
+                batch_begin = batch_end;
+                continue;
+            }
+            responses[batch_begin] = ExecuteUpdate(pending_[batch_begin].request);
+            ++batch_begin;
+        }
+
+        vector<uint64_t> touched_connections;
+        for (size_t i = 0; i < pending_.size(); ++i) {
+            const auto It = connections_.find(pending_[i].connection_id);
+            if (It == connections_.end()) {
+                continue;
+            }
+            EncodeResponse(responses[i], It->second.output);
+            if (touched_connections.empty() || touched_connections.back() != pending_[i].connection_id) {
+                touched_connections.push_back(pending_[i].connection_id);
+            }
+        }
+        pending_.clear();
+        for (const uint64_t connection_id : touched_connections) {
+            Flush(connection_id);
+        }
+        RebalanceIfDue();
+    }
+
+    void RebalanceIfDue() {
+        if (!search_server_.IsTieredStorageEnabled() || finds_since_rebalance_ < REBALANCE_PERIOD) {
+            return;
+        }
+        finds_since_rebalance_ = 0;
+        try {
+            search_server_.RebalanceTieredStorage();
+            cerr << "Tiered storage: "s << search_server_.GetTieredStorageStats() << endl;
+        } catch (const exception& error) {
+            cerr << "Rebalance failed: "s << error.what() << endl;
+        }
+    }
+
+    // Отклонённый запрос индекс не меняет, на него отвечает ExecuteReadOnly.
+    static bool IsReadOnly(const PendingRequest& pending) {
+        const RequestType type = pending.request.type;
+        return !pending.error.empty() || type == RequestType::FIND || type == RequestType::MATCH;
+    }
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    string socket_path;
+    string corpus_path;
+    string stop_words;
+    int tcp_port = 0;
+    string cold_postings_path;
+    size_t memory_budget = 0;
+    for (int i = 1; i < argc; i += 2) {
+        const string_view option = argv[i];
+        if (i + 1 == argc) {
+            cerr << "Missing value for "s << option << endl;
+            return 1;
+        }
+        if (option == "--socket"sv) {
+            socket_path = argv[i + 1];
+        } else if (option == "--corpus"sv) {
+            corpus_path = argv[i + 1];
+        } else if (option == "--stop-words"sv) {
+            stop_words = argv[i + 1];
+        } else if (option == "--tcp"sv) {
+            tcp_port = stoi(argv[i + 1]);
+        } else if (option == "--cold-postings"sv) {
+            cold_postings_path = argv[i + 1];
+        } else if (option == "--memory-budget"sv) {
+            memory_budget = stoull(argv[i + 1]);
+        } else {
+            cerr << "Unknown option "s << option << endl;
+            return 1;
+        }
+    }
+    if (socket_path.empty() && tcp_port == 0) {
+        cerr << "Usage: search_daemon --socket PATH [--tcp PORT] [--corpus FILE] [--stop-words WORDS]"s
+             << " [--cold-postings FILE --memory-budget BYTES]"s << endl;
+        return 1;
+    }
+
+    struct sigaction action{};
+    action.sa_handler = HandleStopSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    try {
+        SearchServer search_server(stop_words);
+        if (!corpus_path.empty()) {
+            const CorpusLoadStats stats = LoadCorpus(search_server, corpus_path);
+            cerr << "Loaded "s << stats.document_count << " documents, "s << stats.byte_count << " bytes"s << endl;
+        }
+        if (!cold_postings_path.empty()) {
+            search_server.EnableTieredStorage({cold_postings_path, memory_budget});
+            cerr << "Tiered storage: "s << search_server.GetTieredStorageStats() << endl;
+        }
+
+        SearchDaemon daemon(search_server);
+        if (!socket_path.empty()) {
+            daemon.AddListener(ListenUnix(socket_path));
+        }
+        if (tcp_port != 0) {
+            daemon.AddListener(ListenTcp(static_cast<uint16_t>(tcp_port)));
+        }
+        daemon.Run();
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    if (!socket_path.empty()) {
+        unlink(socket_path.c_str());
+    }
+    return 0;
+}